@@ -0,0 +1,78 @@
+/*
+  Timing the hot pieces of a search, for --bench.
+
+  Each Kernel adds up the time taken, the number of calls, and the bytes that each call
+    reads and writes. The bytes are counted by the caller from the sizes of the arrays
+    that the kernel goes through, so they are what the kernel has to move, not what a
+    hardware counter would measure. report() then prints ns per call and GB/s.
+  Calls are timed in batches of reps, so that reading the clock is not most of what is
+    measured. keep() stops the compiler from skipping work whose result is never used.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+
+namespace bench {
+
+
+class Kernel {
+public:
+  explicit Kernel(const char *name) : name(name), seconds(0), calls(0), bytes(0) {}
+
+  // call f() reps times, where each call moves bytesPerCall bytes
+  template <class F>
+  void time(int reps, double bytesPerCall, F f) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r=0; r<reps; r++)
+      f();
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    calls += reps;
+    bytes += reps * bytesPerCall;
+  }
+
+  const char *name;
+  double seconds;
+  uint64_t calls;
+  double bytes;
+};
+
+
+template <class T>
+inline void keep(const T &value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+
+inline void report(const std::vector<Kernel *> &kernels) {
+  std::cout << "  " << std::left << std::setw(22) << "kernel" << std::right
+            << std::setw(12) << "calls" << std::setw(12) << "ns/call"
+            << std::setw(14) << "bytes/call" << std::setw(10) << "GB/s" << '\n';
+  for (size_t k=0; k<kernels.size(); k++) {
+    const Kernel &kernel = *kernels[k];
+    std::cout << "  " << std::left << std::setw(22) << kernel.name << std::right
+              << std::setw(12) << kernel.calls;
+    if (kernel.calls == 0) {
+      std::cout << "   (no states reached it)\n";
+      continue;
+    }
+    std::cout << std::fixed << std::setprecision(1)
+              << std::setw(12) << 1e9 * kernel.seconds / kernel.calls
+              << std::setw(14) << kernel.bytes / kernel.calls
+              << std::setprecision(2)
+              << std::setw(10) << (kernel.seconds > 0 ? 1e-9 * kernel.bytes / kernel.seconds : 0.0) << '\n';
+  }
+  std::cout << std::defaultfloat << std::flush;
+}
+
+
+}  // namespace bench
+
+
+#endif
@@ -0,0 +1,138 @@
+/*
+  Upper bounds on how far a search can still get, for --bound.
+
+  The look-ahead prune stops when some number up to best+1 has no box left. This looks
+    further, at the same numbers, with a relaxation that only ever allows more than
+    the search could really do, so pruning with it never loses a solution...
+   - units: a number that has only one box left has to go in that box if the search
+       gets that far. Going up from n, each such number is put in its box as if it were
+       placed, which adds its sums and its double to what that box cannot take, and
+       then a later number may have no box left, or only one. The numbers that have a
+       choice are left out, as if they went nowhere, which can only leave more boxes.
+  firstUnreachable() returns the first number that cannot be reached, or 0.
+  A capacity bound (under Rule #2 alone, a box takes at most ceil(L/2) of each run x,
+    2x, 4x, ... of L numbers) was tried too, but it never pruned a node that units had
+    not, and it about doubled the time of --bound, so it was taken out.
+
+  The counts of nodes checked and pruned are kept for each thread and
+    added together when the thread ends, like searchStats.h, and report() prints them.
+*/
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+
+namespace bounds {
+
+
+struct Counters {
+  uint64_t checked, prunedByUnits;
+  Counters() : checked(0), prunedByUnits(0) {}
+};
+
+inline std::mutex &totalMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline Counters &total() {
+  static Counters counters;
+  return counters;
+}
+
+// the counters of this thread, which are added to total() when the thread ends
+struct ThreadCounters : Counters {
+  ~ThreadCounters() { collect(); }
+  void collect() {
+    std::lock_guard<std::mutex> lock(totalMutex());
+    total().checked += checked;
+    total().prunedByUnits += prunedByUnits;
+    *(Counters *)this = Counters();
+  }
+};
+
+inline ThreadCounters &local() {
+  static thread_local ThreadCounters counters;
+  return counters;
+}
+
+// Print the counts, then start counting again. Other threads must have already ended.
+inline void report() {
+  local().collect();
+  Counters &c = total();
+  std::cout << "  bounds: " << c.checked << " nodes checked, " << c.prunedByUnits << " pruned by units\n" << std::flush;
+  c = Counters();
+}
+
+
+// bits [0, words*64) of to |= from << shift, from the top down so that from can be to
+inline void orShifted(uint64_t *to, const uint64_t *from, uint32_t shift, uint32_t words) {
+  uint32_t sdiv = shift >> 6, smod = shift & 63;
+  for (uint32_t i = words; i-- > sdiv; ) {
+    uint64_t word = from[i - sdiv] << smod;
+    if (smod && i > sdiv)   // smod=0 needs to be handled separately because of the undefined right bitshift
+      word |= from[i - sdiv - 1] >> (64 - smod);
+    to[i] |= word;
+  }
+}
+
+inline bool has(const uint64_t *row, uint32_t i) { return (row[i >> 6] >> (i & 63)) & 1; }
+inline void set(uint64_t *row, uint32_t i)       { row[i >> 6] |= (uint64_t)1 << (i & 63); }
+
+
+// The first number from n to last that the search cannot get to, or 0 if there is none.
+// boxesOf(m) is the boxes that m can go in. copySums(box, row, words) writes the first
+//   words words of the row of sums of box to row, which is only done for the boxes of
+//   propagate, whose one-box numbers are placed as units, so a box whose sums are not
+//   kept as a row (sumIntervals.h) only becomes one if a unit needs it.
+template <class possType, class BoxesOf, class CopySums>
+uint32_t firstUnreachable(BoxesOf boxesOf, CopySums copySums, int boxNum, possType propagate,
+                          uint32_t n, uint32_t last) {
+  static thread_local std::vector<uint64_t> scratch;
+  uint32_t words = (last >> 6) + 1;
+  scratch.assign(2 * (size_t)boxNum * words, 0);
+  uint64_t *sumsOf = scratch.data();                        // the sums of each box with its units
+  uint64_t *blocked = sumsOf + (size_t)boxNum * words;       // numbers that the units keep out of each box
+  possType copied = 0;
+  local().checked++;
+
+  for (uint32_t m = n; m <= last; m++) {
+    possType options = boxesOf(m);
+    for (possType c = options & copied; c; c &= c - 1) {
+      int box = __builtin_ctz(c);
+      if (has(blocked + box * words, m))
+        options &= ~((possType)1 << box);
+    }
+    if (!options) {
+      local().prunedByUnits++;
+      return m;
+    }
+
+    // a unit
+    if (!(options & (options - 1)) && (options & propagate)) {
+      int box = __builtin_ctz(options);
+      uint64_t *row = sumsOf + box * words;
+      if (!(copied & options)) {
+        copySums(box, row, words);
+        copied |= options;
+      }
+      orShifted(blocked + box * words, row, m, words);
+      if (2*m <= last)
+        set(blocked + box * words, 2*m);
+      orShifted(row, row, m, words);
+      set(row, m);
+    }
+  }
+  return 0;
+}
+
+
+}  // namespace bounds
+
+
+#endif
@@ -9,7 +9,8 @@
     g++ -O3 -std=c++11 boxes.cpp
   To run, do something like either of the following...
     ./a.out
-    ./a.out 0,1,0,2,0,1 > log1.txt
+    ./a.out --boxes 5 0,1,0,2,0,1 > log1.txt
+  --boxes sets boxNum (default 4, at most maxBoxNum=8).
   If a string of comma-separated numbers is an argument, these are the starting boxes.
   So, above, 1 would be placed in box 0, 2 in box 1, 3 in box 0, etc.
   Using the command-line argument allows you to split up the task across many CPU cores.
@@ -17,6 +18,41 @@
     because placing in box 2 skipped box 1.
     If you skip a box, no warning will be given, and you cannot trust the output of the code.
 
+  Other options (compile with -pthread for the first two)...
+    --threads 8        search on 8 threads, sharing best
+    --split 10         branches placing n <= 10 become tasks for the threads
+                         (default 2*boxNum past the starting state)
+    --generate DIR 6   write the states at depth 6 as tasks in DIR/jobs/ (see jobFolder.h)
+    --balance DIR 500  the same, but split until no task is estimated at over 1/500 of the total
+    --worker DIR       run tasks from DIR until there are none (--stale, default 600 seconds)
+    --checkpoint FILE  save where the search is every --every seconds (default 600)
+    --resume FILE      continue from a checkpoint, with the same --boxes and --rules
+    --simd LEVEL       scalar, avx2, or avx512 for the kernels of simdKernels.h,
+                         if the CPU has it (default the best it has)
+    --bench 200        time the pieces of step() on 200 random probes (see bench())
+    --estimate 1000    estimate the size and time of the search from 1000 random probes
+    --best 73          start best at 73, for --estimate, --balance, or a real search
+    --stats FILE       where STATS builds write their counters (default stats.json)
+    --solutions FILE   write each new best to FILE (.jsonl, .bin, and .gz with
+                         -DUSE_ZLIB -lz; see solutionStream.h and verify.cpp)
+    --countAll         count every solution for best instead of printing them
+    --sample 1000      with --countAll and --solutions, keep 1000 random ones for best
+    --bound            also prune with the units bound of bounds.h
+    --table 256        skip states already searched, with a 256 MB table (see transposition.h)
+    --replace POLICY   always or bigger (default), which entry the table keeps
+    --tableDepth 10    levels below the starting state that use the table (default 2*boxNum)
+    --rules SET        puzzle (default), schur, or triples (see rules.h)
+    --checkSchur       search 1 to 4 boxes with the schur rules and compare with 1, 4, 13, 44
+  --countAll does not work with --table or checkpoints, --bound only works with the
+    puzzle's rules, and checkpoints do not work with --threads.
+  The README has what each of these did to the time on my computer.
+
+  Uncommenting "#define STATS" counts the calls of step(), prunes, leaves, branches,
+    and skipped symmetric boxes at each depth. "#define UNDO_TRAIL" undoes the changes
+    to one possibilities[] instead of copying it, and "#define BIT_PLANES" keeps a bitset
+    of numbers for each box instead of a byte of boxes for each number. Both were
+    slower here (see the README), and they cannot be combined.
+
   To compile for deploying on any Windows machine, I did...
     x86_64-w64-mingw32-g++ -static -O3 -std=c++11 boxes.cpp
   I obtained this command via Cygwin's mingw64-x86_64-gcc-g++ package.
@@ -25,13 +61,11 @@
     If you input a state, the actual best is just the best given that starting state.
 
 
-  Before compiling, all you have to set is boxNum !
-
-  You may also want to change the "best = 0" line to try to speed things up,
-    though I never worried about changing it.
+  Nothing needs to be set before compiling. Give --boxes to workers too.
 
   To print ALL of the best solutions, there are two commented lines of code to change.
-  Search this file for "ALL best solutions" to find them.
+  Search this file for "ALL best solutions" to find them. With --bound, also change
+    bestNow+1 to bestNow where it is used in step(). To only count them, use --countAll.
 
   For boxNum > 4, uncommenting out the code that says "print progress" above it
     can be helpful to see the progress made by the most shallow levels of recursion.
@@ -43,24 +77,93 @@
 */
 
 
+// Count nodes, prunes, leaves, and skipped symmetric boxes at each depth of the
+//   search, and write them to --stats (default stats.json). See searchStats.h.
+//#define STATS
+
 #include <iostream>
 #include <chrono>
 #include <ctime>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <queue>
+#include <algorithm>
+#include <map>
+
+#include "workStealingPool.h"
+#include "jobFolder.h"
+#include "checkpoint.h"
+#include "simdKernels.h"
+#include "bench.h"
+#include "searchStats.h"
+#include "estimate.h"
+#include "solutionStream.h"
+#include "transposition.h"
+#include "bounds.h"
+#include "rules.h"
+
+std::atomic<int> best;     // relaxed loads of this compile to plain loads on x86
+std::atomic<bool> increaseNeeded;
+
+std::mutex printMutex;            // new bests are printed one at a time
+solutionStream::Writer solutions; // if opened, new bests are written here instead of printed (see --solutions)
+
+WorkStealingPool *pool = nullptr; // only used if --threads is more than 1
+int splitDepth;                   // branches placing n <= splitDepth become pool tasks
+int splitOption = 0;              // --split, or 0 for 2*boxNum past the starting state
+int numThreads = 1;
+
+int generateDepth = 0;                   // if not 0, collect the states at this depth instead of searching
+std::vector<std::string> generated;
+
+std::atomic<bool> checkpointDue(false);  // set by the checkpoint timer
+int checkpointSeconds = 600;
+std::string checkpointFile;
+std::string resumeFile;
+int prefixLength;                        // numbers placed by the starting state
+int resumeUntil = 0;                     // resuming while placing n < resumeUntil
+
+int benchProbes = 0;                     // if not 0, time the pieces of step() instead of searching
 
-int best;
-bool increaseNeeded;
+std::string statsFile = "stats.json";    // where STATS builds write the counters
 
+int estimateProbes = 0;                  // if not 0, estimate the size of the search instead of searching
+int startBest = 0;                       // what best starts at (see --best)
 
+int balanceTasks = 0;                    // if not 0, split the search into this many tasks for --balance
+int balanceProbes = 200;                 // probes used to estimate the cost of each task for --balance
 
+transposition::Table table;              // subtrees already searched, if --table is given
+int tableDepth = 0;                      // levels below the starting state that use the table (see --table)
 
-const uint8_t boxNum = 4;
+rules::Set ruleSet = rules::puzzle;      // the rules to search with (see --rules)
+
+bool useBounds = false;                  // prune with the bound of bounds.h too (see --bound)
+
+bool countAll = false;                   // count every solution for best instead of printing it (see --countAll)
+size_t sampleSize = 0;                   // for --countAll, how many solutions for best to keep, or 0 for all
+std::map<int, uint64_t> solutionCounts;  // for --countAll, the solutions found for each value
+std::vector<std::string> kept;           // for --countAll, boxes[1..best] of the solutions kept for --solutions
+uint64_t keptOf = 0;                     // how many solutions for best there were to keep them from
+std::mt19937_64 sampleRandom(1);         // picks which ones are kept, the same way every time
+thread_local uint64_t tableNodes = 0;    // calls of step() on this thread, for the sizes of subtrees
+
+
+
+
+const uint8_t maxBoxNum = 8;
 // not greater than 8 while possibilities is uint8_t
 // not greater than 10 while argv[1] processing only looks for single-digit arguments
 //
-// I do not pass this as a command line argument because I want the compiler to
-//   try to optimize as much as it can! Though I have not tested making this a
-//   a command line argument...
+// I want the compiler to optimize as much as it can for each number of boxes, so the
+//   search is a template, Boxes<boxNum, SumRule, MultipleRule>, and --boxes picks which
+//   one to run. Every boxNum from 1 to maxBoxNum is compiled into the executable, for
+//   each set of rules that --rules can pick (see rules.h).
 
 
 
@@ -68,25 +171,273 @@ const uint8_t boxNum = 4;
   found max number will go up to maxSteps-1
 */
 
-const uint16_t maxSteps = 3 << (uint16_t) boxNum;   // this seems safe
+const uint16_t maxMaxSteps = 3 << (uint16_t) maxBoxNum;   // maxSteps for maxBoxNum
+
+thread_local uint8_t boxes[maxMaxSteps + 1];  // faster using int instead?
+// thread_local because each thread of the parallel search walks its own branch
+
+
+
+// Instead of copying possibilities[n+1..maxSteps] at every step, remove boxes from
+//   possibilities[] itself, and write down each number whose box was removed.
+//   After the step, those boxes are added back. The cost of a step is then the number
+//   of boxes it removes instead of maxSteps.
+// A box is only removed from each number once along a branch, so trail[] can never
+//   hold more than maxSteps*boxNum numbers.
+//#define UNDO_TRAIL
+
+// Instead of possibilities[n] holding a bit for each box, hold a bitset of numbers for
+//   each box, possibilities[box][], laid out like sums[box][]. Removing the NEWsums from
+//   a box is then possibilities[box][i] &= ~NEWsums[i] on whole 64-bit words, and
+//   "can n go in any box" is an OR across the boxes.
+//#define BIT_PLANES
+
+#if defined(BIT_PLANES) && defined(UNDO_TRAIL)
+#error "BIT_PLANES and UNDO_TRAIL cannot be used together"
+#endif
+
+#ifdef UNDO_TRAIL
+thread_local uint16_t trail[(maxMaxSteps + 1) * maxBoxNum];
+thread_local int trailTop = 0;
+#endif
+
+// Remove box (bit is 1<<box) from possibilitiesNew[j].
+// top is the end of trail[], kept in a local variable by step() because
+//   thread_local variables are slower to use.
+inline void removeBox(uint8_t *possibilitiesNew, int j, uint8_t bit, uint16_t *&top) {
+#ifdef UNDO_TRAIL
+  *top = j;                                  // only kept if the box was there to remove
+  top += (possibilitiesNew[j] & bit) != 0;
+#else
+  (void)top;
+#endif
+  possibilitiesNew[j] &= ~bit;
+}
+
+#ifdef UNDO_TRAIL
+// add back the boxes removed from start to top, and end trail[] at start again
+inline void undoTrail(uint8_t *possibilities, uint16_t *start, const uint16_t *top, uint8_t bit) {
+  while (top > start)
+    possibilities[*--top] |= bit;
+  trailTop = start - trail;
+}
+#endif
+
+uint8_t resumePath[maxMaxSteps + 1];  // boxes[] of the checkpoint being resumed
 
 
 
+// the search for boxNum boxes, with Rule #1 being SumRule and Rule #2 being MultipleRule
 
-const uint16_t sumsLength = ( maxSteps>>6 ) + 1;
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+struct Boxes {
 
-uint8_t boxes[maxSteps + 1];  // faster using int instead?
+  static const uint16_t maxSteps = 3 << (uint16_t) boxNum;   // this seems safe
 
-// bit mask for updating the "final" 64-bit chunk of a sums[box]
-//   to remove out-of-bounds (greater than maxSteps) bits
-const uint64_t sumsMask = (~((uint64_t)0)) >> (63 - (maxSteps & 63));
+  static const uint16_t sumsLength = ( maxSteps>>6 ) + 1;
+
+  // bit mask for updating the "final" 64-bit chunk of a sums[box]
+  //   to remove out-of-bounds (greater than maxSteps) bits
+  static const uint64_t sumsMask = (~((uint64_t)0)) >> (63 - (maxSteps & 63));
+
+#ifdef BIT_PLANES
+  typedef uint64_t Possibilities[boxNum][sumsLength];   // bit n of [box] is set if n can go in box
+#else
+  typedef uint8_t Possibilities[maxSteps+1];            // bit box of [n] is set if n can go in box
+#endif
+
+  // the same for either layout of possibilities
+  static uint8_t boxesOf(const Possibilities possibilities, int n);
+  static void removeFrom(Possibilities possibilities, int n, int box);
+  static void fill(Possibilities possibilities, bool every);
+  static int firstDead(const Possibilities possibilities, int from);
+  static int removeNewSums(Possibilities possibilitiesNew, const uint64_t NEWsums[sumsLength], int ndiv, int box, int dead);
+  static void copyPossibilities(Possibilities possibilitiesNew, const Possibilities possibilities, int n);
+
+  static void newSums(const uint64_t sums[sumsLength], int n, uint64_t NEWsums[sumsLength]);
+
+  static void printBoxes( int step );
+  static void writeSolution( const uint8_t boxesOfNumbers[], int step );
+  static void countSolution( int step );
+  static void reportCounts();
+  static void initialize(Possibilities possibilities, uint64_t sums[boxNum][sumsLength], uint16_t n_final, int state[]);
+  static void writeCheckpoint(uint16_t n);
+  static uint64_t stateKey(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int end);
+  static void spawn(Possibilities possibilitiesNew, uint64_t sumsNew[boxNum][sumsLength], uint16_t n, int dead);
+  static void step(Possibilities possibilities, uint64_t sums[boxNum][sumsLength], uint16_t n, int dead);
+  static void search(std::vector<int> temp);
+  static void bench(int probes);
+  static int makeChild(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int dead, int box,
+                       Possibilities possibilitiesNew, uint64_t sumsNew[boxNum][sumsLength]);
+  static void probe(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int dead, int probes,
+                    std::mt19937 &random, estimate::Mean &nodes, estimate::Mean &seconds);
+  static void estimate(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int dead, int probes);
+  static int setUp(const std::vector<int> &temp, Possibilities possibilities, uint64_t sums[boxNum][sumsLength]);
+  static void balance(const std::vector<int> &temp, int tasks);
+
+};
+
+template <uint8_t boxNum, class SumRule, class MultipleRule> const uint16_t Boxes<boxNum, SumRule, MultipleRule>::maxSteps;
+template <uint8_t boxNum, class SumRule, class MultipleRule> const uint16_t Boxes<boxNum, SumRule, MultipleRule>::sumsLength;
+template <uint8_t boxNum, class SumRule, class MultipleRule> const uint64_t Boxes<boxNum, SumRule, MultipleRule>::sumsMask;
+
+
+
+#ifdef BIT_PLANES
+
+// the boxes that n can go in
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline uint8_t Boxes<boxNum, SumRule, MultipleRule>::boxesOf(const Possibilities possibilities, int n) {
+  uint8_t options = 0;
+  for (int box=0; box<boxNum; box++)
+    options |= ((possibilities[box][n >> 6] >> (n & 63)) & 1) << box;
+  return options;
+}
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline void Boxes<boxNum, SumRule, MultipleRule>::removeFrom(Possibilities possibilities, int n, int box) {
+  possibilities[box][n >> 6] &= ~((uint64_t)1 << (n & 63));
+}
+
+// every box for each of 1 through maxSteps, or no boxes for any number
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::fill(Possibilities possibilities, bool every) {
+  for (int box=0; box<boxNum; box++) {
+    for (int i=0; i<sumsLength; i++)
+      possibilities[box][i] = every ? ~(uint64_t)0 : 0;
+    possibilities[box][0] &= ~(uint64_t)1;              // possibilities of 0 is never used
+    possibilities[box][sumsLength-1] &= sumsMask;       // nothing past maxSteps
+  }
+}
+
+// the first number from "from" onwards that cannot go in any box, or maxSteps+1
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+int Boxes<boxNum, SumRule, MultipleRule>::firstDead(const Possibilities possibilities, int from) {
+  for (int i = from >> 6; i < sumsLength; i++) {
+    uint64_t any = 0;
+    for (int box=0; box<boxNum; box++)
+      any |= possibilities[box][i];
+    uint64_t none = ~any;
+    if (i == from >> 6)
+      none &= ~(uint64_t)0 << (from & 63);
+    if (i == sumsLength-1)
+      none &= sumsMask;
+    if (none)
+      return __builtin_ctzll(none) + (i << 6);
+  }
+  return maxSteps+1;
+}
+
+// Remove NEWsums from box, and return dead updated with the numbers that this leaves with no boxes.
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline int Boxes<boxNum, SumRule, MultipleRule>::removeNewSums(Possibilities possibilitiesNew, const uint64_t NEWsums[sumsLength], int ndiv, int box, int dead) {
+  // whole words at a time, then a number that was just removed is dead if no other box has it
+  for (int i = ndiv; i < sumsLength; i++) {
+    uint64_t removed = possibilitiesNew[box][i] & NEWsums[i];
+    possibilitiesNew[box][i] &= ~NEWsums[i];
+    if (removed && (i << 6) < dead) {
+      uint64_t any = 0;
+      for (int b=0; b<boxNum; b++)
+        any |= possibilitiesNew[b][i];
+      removed &= ~any;
+      if (removed && __builtin_ctzll(removed) + (i << 6) < dead)
+        dead = __builtin_ctzll(removed) + (i << 6);
+    }
+  }
+  return dead;
+}
+
+// copy starting at the word holding n+1
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline void Boxes<boxNum, SumRule, MultipleRule>::copyPossibilities(Possibilities possibilitiesNew, const Possibilities possibilities, int n) {
+  for (int b=0; b<boxNum; b++)
+    for (int i=((n+1) >> 6); i<sumsLength; i++)
+      possibilitiesNew[b][i] = possibilities[b][i];
+}
+
+#else
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline uint8_t Boxes<boxNum, SumRule, MultipleRule>::boxesOf(const Possibilities possibilities, int n) {
+  return possibilities[n];
+}
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline void Boxes<boxNum, SumRule, MultipleRule>::removeFrom(Possibilities possibilities, int n, int box) {
+  possibilities[n] &= ~((uint8_t)1 << box);
+}
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::fill(Possibilities possibilities, bool every) {
+  for (int i=1; i<=maxSteps; i++)   // possibilities[0] is never used
+    possibilities[i] = every ? (1 << boxNum) - 1 : 0;   // each bit is a box
+}
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+int Boxes<boxNum, SumRule, MultipleRule>::firstDead(const Possibilities possibilities, int from) {
+  return simd::firstZero(possibilities, from, maxSteps+1);
+}
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline int Boxes<boxNum, SumRule, MultipleRule>::removeNewSums(Possibilities possibilitiesNew, const uint64_t NEWsums[sumsLength], int ndiv, int box, int dead) {
+  // many at a time using AVX2 or AVX-512 if the CPU has it (see simdKernels.h)
+  int zero = simd::clearBits(possibilitiesNew, NEWsums, ndiv, sumsLength, maxSteps+1, (uint8_t)(1 << box));
+  return zero < dead ? zero : dead;
+}
+
+// copy starting at n+1
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline void Boxes<boxNum, SumRule, MultipleRule>::copyPossibilities(Possibilities possibilitiesNew, const Possibilities possibilities, int n) {
+  for (int i=n+1; i<maxSteps+1; i++)
+    possibilitiesNew[i] = possibilities[i];
+}
+
+#endif
+
+
+
+// NEWsums are the new sums of a box when n is put in it, meaning the values in sumsNew
+//   that aren't also in sums...
+//   NEWsums = sumsNew & ~sums
+// Though this is not exactly the way the following "magic" code does it.
+// For rules other than Rule #1, SumRule says which of sums shifted by n are new (see
+//   rules.h), and this is the same code for Rule #1.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+inline void Boxes<boxNum, SumRule, MultipleRule>::newSums(const uint64_t sums[sumsLength], int n, uint64_t NEWsums[sumsLength]) {
+
+  int nmod = n & 63;   // n%64
+  int ndiv = n >> 6;   // n/64
+
+  // magic happens!
+  // The goal is to find NEWsums using bitshifts of sums[],
+  //   keeping in mind that sums[] comes in chunks of 64 bits,
+  //   so each original chunk can affect 2 chunks.
+  // Note that NEWsums[i] where i < ndiv is never stored or accessed.
+  NEWsums[ndiv] = SumRule::newSums(sums[0] << nmod, sums[ndiv]);
+  if (nmod == 0) {   // needs to be handled separately to prevent annoyingly-undefined behavior of right bitshift when nmod=0
+    for (int i = ndiv + 1; i < sumsLength; i++)
+      NEWsums[i] = SumRule::newSums(sums[i - ndiv],
+                                    sums[i]);
+  } else {
+    for (int i = ndiv + 1; i < sumsLength; i++)
+      NEWsums[i] = SumRule::newSums((sums[i - ndiv] << nmod) |
+                                    (sums[i - ndiv - 1] >> (64 - nmod)),
+                                    sums[i]);
+  }
+
+  // necessary to prevent possibilitiesNew being written to out-of-bounds
+  NEWsums[sumsLength - 1] &= sumsMask;
+
+}
 
 
 
 // I decided to print the current best each time a new best is found
 //   because I really want to find ALL forms of the optimal solution.
 
-void printBoxes( int step ) {
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::printBoxes( int step ) {
 
 /*
     // print boxes[] directly
@@ -126,32 +477,103 @@ void printBoxes( int step ) {
 
 
 
+// write boxesOfNumbers[1..step], like boxes[], to solutions as runs of consecutive
+//   numbers in the same box
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::writeSolution( const uint8_t boxesOfNumbers[], int step ) {
+  std::vector<solutionStream::Run> runs;
+  for (int i=1; i <= step; i++) {
+    if (!runs.empty() && runs.back().box == boxesOfNumbers[i]) {
+      runs.back().last = i;
+    } else {
+      solutionStream::Run run = {boxesOfNumbers[i], (uint32_t)i, (uint32_t)i};
+      runs.push_back(run);
+    }
+  }
+  solutions.write(step, boxNum, runs);
+}
+
+
+
+// For --countAll, count the solution placing 1 to step, which is at least best.
+// Empty boxes are only ever tried in order (see step()), so each solution is found
+//   once up to renaming the boxes, and boxes[] is already the same for every renaming.
+//   That makes boxes[1..step], a byte per number, both the key of a solution and what
+//   is kept of it. If sampleSize is not 0, kept[] is a uniform sample of sampleSize of
+//   the solutions for best (reservoir sampling), else it is all of them.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::countSolution( int step ) {
+  std::lock_guard<std::mutex> lock(printMutex);
+  if (step < best)   // another thread got past it first
+    return;
+  if (step > best) {
+    best = step;
+    kept.clear();
+    keptOf = 0;
+    std::cout << step << '\n' << std::flush;
+  }
+  solutionCounts[step]++;
+  if (!solutions.opened())
+    return;
+  keptOf++;
+  std::string solution((const char *)boxes, step + 1);
+  if (!sampleSize || kept.size() < sampleSize) {
+    kept.push_back(solution);
+  } else {
+    uint64_t i = sampleRandom() % keptOf;
+    if (i < sampleSize)
+      kept[i] = solution;
+  }
+}
+
+// print the counts of --countAll, and write the solutions that were kept
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::reportCounts() {
+  std::cout << "  solutions of each value, up to renaming the boxes:\n";
+  for (std::map<int, uint64_t>::reverse_iterator i = solutionCounts.rbegin(); i != solutionCounts.rend(); ++i) {
+    std::cout << "    " << i->first << ": " << i->second;
+    if (i->first < best)
+      std::cout << " (only the ones found before best got past " << i->first << ")";
+    std::cout << '\n';
+  }
+  if (solutionCounts.empty())
+    std::cout << "    none reached best\n";
+  if (solutions.opened()) {
+    for (size_t i=0; i<kept.size(); i++)
+      writeSolution((const uint8_t *)kept[i].data(), best);
+    solutions.flush();
+    std::cout << "  wrote " << kept.size() << " of the " << keptOf << " solutions for " << best << " to --solutions\n";
+  }
+  std::cout << std::flush;
+}
+
+
+
 
 
 // the following function only does anything if starting boxes are passed as a command line argument
 
-void initialize(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLength], uint16_t n_final, int state[]) {
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::initialize(Possibilities possibilities, uint64_t sums[boxNum][sumsLength], uint16_t n_final, int state[]) {
 
   for(uint16_t n=1; n < n_final; n++) {
 
       int box = state[n];
 
       // optionally check possibilities[n]
-      if ( !( possibilities[n] & ((uint8_t)1 << box) ) ) {
+      if ( !( boxesOf(possibilities, n) & ((uint8_t)1 << box) ) ) {
         std::cout << "\n\nBad state provided!!\n\n" << std::flush;
-        for (int i=1; i<=maxSteps; i++)
-          possibilities[i] = 0;
+        fill(possibilities, false);
         boxes[n] = box;
         return;
       }
 
-      // bit mask for removing from possibilitiesNew
-      uint8_t mask = ~((uint8_t)1 << box);
-
       // remove 2*n from possibilities
-      uint16_t j = n << 1;
-      if (j <= maxSteps)
-        possibilities[j] &= mask;  // remove from possibilities
+      int j = MultipleRule::of(n);
+      if (j && j <= maxSteps)
+        removeFrom(possibilities, j, box);  // remove from possibilities
 
       // deep copy
       uint64_t sumsOld[boxNum][sumsLength];
@@ -168,8 +590,8 @@ void initialize(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLen
           uint16_t j = k + (i << 6) + n;   // k + (i<<6) is the sum being added to
           if (j > maxSteps)
             goto endloops;
-          possibilities[j] &= mask;         // remove from possibilities[]
-          sums[box][j >> 6] |= ((uint64_t) 1 << (j & 63));  // add to sums[]
+          removeFrom(possibilities, j, box);   // remove from possibilities[]
+          sums[box][j >> 6] = SumRule::add(sums[box][j >> 6], (uint64_t) 1 << (j & 63));  // add to sums[]
           temp -= ((uint64_t)1 << k);
         }
       }
@@ -192,27 +614,121 @@ endloops:
 
 
 
+// everything needed to continue from the node placing n
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::writeCheckpoint(uint16_t n) {
+  checkpoint::Fields fields;
+  fields["boxNum"] = std::to_string(boxNum);
+  fields["rules"] = rules::name(ruleSet);
+  fields["best"] = std::to_string(best.load());
+  fields["prefix"] = std::to_string(prefixLength);
+  fields["path"] = checkpoint::join(boxes + 1, n - 1);
+  fields["increaseNeeded"] = std::to_string((int)increaseNeeded.load());
+  if (!checkpoint::save(checkpointFile, fields))
+    std::cout << "  could not write checkpoint " << checkpointFile << '\n' << std::flush;
+}
+
+
+
+// the key of the state placing n for the transposition table, from the numbers below end
+//   (see transposition.h)
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+uint64_t Boxes<boxNum, SumRule, MultipleRule>::stateKey(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int end) {
+  if (end > maxSteps+1)
+    end = maxSteps+1;
+  uint64_t h[boxNum];
+#ifdef BIT_PLANES
+  for (int box=0; box<boxNum; box++)
+    h[box] = transposition::hashBits(possibilities[box], n, end, 0);
+#else
+  transposition::hashPlanes(possibilities, n, end, boxNum, h);
+#endif
+  for (int box=0; box<boxNum; box++)
+    h[box] = transposition::hashBits(sums[box], 0, end - n, h[box]);
+  return transposition::combine(h, boxNum, n | ((uint64_t)end << 32));
+}
+
+
+
+// Instead of recursing into the branch where n has just been placed, copy the
+//   branch into a task for the pool. boxes[0..n] is copied too because each
+//   thread has its own boxes[].
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::spawn(Possibilities possibilitiesNew, uint64_t sumsNew[boxNum][sumsLength], uint16_t n, int dead) {
+
+  struct Branch {
+    Possibilities possibilities;
+    uint64_t sums[boxNum][sumsLength];
+    uint8_t boxes[maxSteps+1];
+  };
+
+  std::shared_ptr<Branch> branch = std::make_shared<Branch>();
+  std::memcpy(branch->possibilities, possibilitiesNew, sizeof(branch->possibilities));
+  std::memcpy(branch->sums, sumsNew, sizeof(branch->sums));
+  std::memcpy(branch->boxes, boxes, (n+1) * sizeof(boxes[0]));
+
+  pool->submit([branch, n, dead]() {
+    std::memcpy(boxes, branch->boxes, (n+1) * sizeof(boxes[0]));
+    step(branch->possibilities, branch->sums, n+1, dead);
+  });
+
+}
+
+
+
 // the recursive function to place n
+// dead is the first number from n onwards that cannot be placed (possibilities[dead] is 0),
+//   or maxSteps+1 if there is none. A step only removes boxes, so the caller finds dead
+//   from its own dead and the numbers that this step left with no boxes.
 
-void step(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLength], uint16_t n) {
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::step(Possibilities possibilities, uint64_t sums[boxNum][sumsLength], uint16_t n, int dead) {
+
+  if (checkpointDue.load(std::memory_order_relaxed)) {
+    checkpointDue = false;
+    writeCheckpoint(n);
+  }
+
+  STAT(stats::node(n));
+
+  int bestNow = best.load(std::memory_order_relaxed);
 
   // prune by looking ahead!
-  for (int i = n+1; i < best+2; i++)    // change best+2 to best+1 to get ALL best solutions
-    if (!possibilities[i])
-      return;
+  // If dead is n itself, it is not pruned here, since n-1 might be a new best.
+  if (dead > n && dead < bestNow+2 - countAll) {    // change best+2 to best+1 to get ALL best solutions (or use --countAll)
+    STAT(stats::prune(n, dead - n));
+    return;
+  }
 
   if (n > maxSteps) {
     increaseNeeded = true;
     return;
   }
 
+  STAT(if (dead == n) stats::leaf(n));
+
   // see if we might have a new best!
   int temp = n-1;   // candidate for new best
-  if (temp > best && !possibilities[n]) {     // change > to >= to get ALL best solutions
-    best = temp;
-    std::cout << temp << '\n';
-    printBoxes(temp);
-    std::cout << "\n\n" << std::flush;
+  if (countAll && temp >= bestNow && dead == n) {
+    countSolution(temp);
+    return;
+  }
+  if (temp > bestNow && dead == n) {     // change > to >= to get ALL best solutions
+    std::lock_guard<std::mutex> lock(printMutex);
+    if (temp > best) {     // check again now that no other thread can change best; change > to >= to get ALL best solutions
+      best = temp;
+      if (solutions.opened()) {
+        writeSolution(boxes, temp);
+        std::cout << temp << '\n' << std::flush;
+      } else {
+        std::cout << temp << '\n';
+        printBoxes(temp);
+        std::cout << "\n\n" << std::flush;
+      }
+    }
     return;
   }
 
@@ -239,18 +755,73 @@ void step(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLength],
   else if (temp > depth) return;
 */
 
+  // same as the above, but for --generate
+  if (generateDepth && temp == generateDepth) {
+    std::string state;
+    for (int j=1; j<=temp; j++)
+      state += std::to_string(boxes[j]) + (j<temp ? "," : "");
+    generated.push_back(state);
+    return;
+  }
+
+  // prune if n cannot get past best by the bound of bounds.h (see --bound)
+  if (useBounds && dead > n && n <= bestNow+1) {
+    int last = bestNow+1 - countAll < maxSteps ? bestNow+1 - countAll : maxSteps;   // change to bestNow to get ALL best solutions
+    auto copySums = [&](int box, uint64_t *row, uint32_t words) {
+      for (uint32_t i=0; i<words; i++)
+        row[i] = sums[box][i];
+    };
+    if (bounds::firstUnreachable<uint8_t>([&](uint32_t m) { return boxesOf(possibilities, m); },
+                                          copySums, boxNum, (uint8_t)((1 << boxNum) - 1), n, last))
+      return;
+  }
+
+  // skip states whose subtree was already searched (see --table)
+  uint64_t key = 0;
+  uint64_t nodesBefore = 0;
+  if (table.enabled())   // every step is counted, for the sizes of the subtrees that are stored
+    nodesBefore = tableNodes++;
+  if (table.enabled() && !generateDepth && n >= resumeUntil && n <= prefixLength + tableDepth && n < bestNow+2) {   // else n-1 is already past best
+    key = stateKey(possibilities, sums, n, bestNow+2);
+    uint32_t stored;
+    if (table.find(key, stored) && (int)stored <= bestNow)
+      return;
+  }
+
   // for updating sums[], assuming that it is uint64_t
-  int nmod = n & 63;   // n%64
+  int nmod = n & 63;   // n%64
   int ndiv = n >> 6;   // n/64
 
   // try to place n in each box
-  while(possibilities[n]) {
-      int box = __builtin_ctz( possibilities[n] );   // count trailing zeros
+  // (a copy of possibilities[n] so that possibilities[] is the same when returning)
+  uint8_t options = boxesOf(possibilities, n);
+  while(options) {
+      int box = __builtin_ctz( options );   // count trailing zeros
+
+      // when resuming, the boxes before the one on the checkpoint's path were already searched
+      if (n < resumeUntil) {
+        if (box < resumePath[n]) {
+          options -= ((uint8_t)1 << box);
+          continue;
+        }
+        if (box > resumePath[n])   // the checkpoint's branch is finished
+          resumeUntil = 0;
+      }
 
+#if defined(BIT_PLANES)
+      Possibilities possibilitiesNew;
+      copyPossibilities(possibilitiesNew, possibilities, n);
+#elif defined(UNDO_TRAIL)
+      // change possibilities[] itself, then put it back after the recursive call
+      uint8_t *possibilitiesNew = possibilities;
+      uint16_t *trailStart = trail + trailTop;
+      uint16_t *top = trailStart;
+#else
       // copy starting at n+1
-      uint8_t possibilitiesNew[maxSteps+1];
-      for (int i=n+1; i<maxSteps+1; i++)
-        possibilitiesNew[i] = possibilities[i];
+      Possibilities possibilitiesNew;
+      copyPossibilities(possibilitiesNew, possibilities, n);
+      uint16_t *top = nullptr;
+#endif
 
       // deep copy
       uint64_t sumsNew[boxNum][sumsLength];
@@ -258,67 +829,66 @@ void step(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLength],
         for (int j=0; j<sumsLength; j++)
           sumsNew[i][j] = sums[i][j];
 
-      // bit mask for removing from possibilitiesNew
-      uint8_t mask = ~((uint8_t)1 << box);
+      // bit for removing from possibilitiesNew
+      uint8_t bit = (uint8_t)1 << box;
+
+      // dead for the next step (dead > n since possibilities[n] is not 0)
+      int deadNew = dead;
 
       // remove 2*n from possibilitiesNew
-      uint16_t j = n << 1;
-      if (j <= maxSteps)
-        possibilitiesNew[j] &= mask;  // remove from possibilities
+      int j = MultipleRule::of(n);
+      if (j && j <= maxSteps) {
+#ifdef BIT_PLANES
+        removeFrom(possibilitiesNew, j, box);
+#else
+        removeBox(possibilitiesNew, j, bit, top);  // remove from possibilities
+#endif
+        if (!boxesOf(possibilitiesNew, j) && j < deadNew)
+          deadNew = j;
+      }
 
 
 
-      // NEWsums are the new sums, meaning the values in sumsNew that aren't also in sums...
-      //   NEWsums = sumsNew & ~sums
-      // Though this is not exactly the way the following "magic" code does it.
+      // NEWsums are the new sums, meaning the values in sumsNew that aren't also in sums
       uint64_t NEWsums[sumsLength];
-
-      // magic happens!
-      // The goal is to find NEWsums using bitshifts of sums[],
-      //   keeping in mind that sums[] comes in chunks of 64 bits,
-      //   so each original chunk can affect 2 chunks.
-      // Note that NEWsums[i] where i < ndiv is never stored or accessed.
-      NEWsums[ndiv] = (sums[box][0] << nmod) & (~sums[box][ndiv]);
-      if (nmod == 0) {   // needs to be handled separately to prevent annoyingly-undefined behavior of right bitshift when nmod=0
-        for (int i = ndiv + 1; i < sumsLength; i++)
-          NEWsums[i] = sums[box][i - ndiv] &
-                       (~sums[box][i]);
-      } else {
-        for (int i = ndiv + 1; i < sumsLength; i++)
-          NEWsums[i] = ((sums[box][i - ndiv] << nmod) |
-                        (sums[box][i - ndiv - 1] >> (64 - nmod))) &
-                       (~sums[box][i]);
-      }
-
-      // necessary to prevent possibilitiesNew being written to out-of-bounds
-      NEWsums[sumsLength - 1] &= sumsMask;
+      newSums(sums[box], n, NEWsums);
 
       // updating possibilitiesNew by removing NEWsums
+#ifdef UNDO_TRAIL
       for (int i = ndiv; i < sumsLength; i++) {
         uint64_t temp = NEWsums[i]; // temp represents 64 possible sums
         while (temp) {
           int k = __builtin_ctzll(temp);          // count trailing zeros
-          possibilitiesNew[k + (i << 6)] &= mask; // remove from possibilities[]
+          removeBox(possibilitiesNew, k + (i << 6), bit, top); // remove from possibilities[]
           temp &= temp - 1;   // remove the lowest set bit, where   temp -= ((uint64_t)1 << k)   is same thing
         }
       }
-
-      // update sumsNew by adding NEWsums
-      NEWsums[ndiv] |= ((uint64_t)1 << nmod);   // add n to NEWsums
+      for (uint16_t *t = trailStart; t < top; t++)   // the numbers that just lost a box
+        if (!possibilitiesNew[*t] && *t < deadNew)
+          deadNew = *t;
+#else
+      deadNew = removeNewSums(possibilitiesNew, NEWsums, ndiv, box, deadNew);
+#endif
+
+      // update sumsNew by adding NEWsums and n
       for (int i = ndiv; i < sumsLength; i++)
-        sumsNew[box][i] |= NEWsums[i];
+        sumsNew[box][i] = SumRule::add(sumsNew[box][i], NEWsums[i]);
+      sumsNew[box][ndiv] |= ((uint64_t)1 << nmod);
 
 
 
       // place n
       boxes[n] = box;
+#ifdef UNDO_TRAIL
+      trailTop = top - trail;   // deeper steps continue trail[] from here
+#endif
 
 /*
       // useful for boxNum=3 to map out the recursion tree
       // If doing this, perhaps comment out the non-initial pruning
       std::cout << ' ' << n << ' ' << box << '\n';
-      // An unimplemented idea to get a sense of the tree (useful even for boxNum > 3) is to
-      // have an array that counts how many times a branch terminates at each depth.
+      // To get a sense of the tree (useful even for boxNum > 3), see "#define STATS",
+      // which counts how many times a branch terminates at each depth.
 */
 
 
@@ -326,19 +896,37 @@ void step(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLength],
       // If n is placed in the first unused box, then placing n in any later unused
       // box would only rename boxes. Therefore, after searching this branch, return
       // instead of trying later empty boxes.
+      STAT(stats::child(n));
       if (box == boxes[0]) {
+        STAT(stats::symmetrySkip(n, __builtin_popcount(options) - 1));   // the later empty boxes
         boxes[0] = box+1;
-        step(possibilitiesNew, sumsNew, n+1);
+        if (pool && n <= splitDepth)
+          spawn(possibilitiesNew, sumsNew, n, deadNew);
+        else
+          step(possibilitiesNew, sumsNew, n+1, deadNew);
         boxes[0] = box;
-        return;
+#ifdef UNDO_TRAIL
+        undoTrail(possibilities, trailStart, top, bit);
+#endif
+        break;
       }
 
 
-      step(possibilitiesNew, sumsNew, n+1);
+      if (pool && n <= splitDepth)
+        spawn(possibilitiesNew, sumsNew, n, deadNew);
+      else
+        step(possibilitiesNew, sumsNew, n+1, deadNew);
 
-      possibilities[n] -= ((uint8_t)1 << box);  // so that the while loop progresses
+#ifdef UNDO_TRAIL
+      undoTrail(possibilities, trailStart, top, bit);
+#endif
+      options -= bit;  // so that the while loop progresses
 
   }
+
+  // Spawned branches are not done yet, and, if best changed, the key's end is too small.
+  if (key && !(pool && n <= splitDepth) && best.load(std::memory_order_relaxed) == bestNow && !increaseNeeded)
+    table.store(key, bestNow, tableNodes - nodesBefore);
 }
 
 
@@ -346,20 +934,46 @@ void step(uint8_t possibilities[maxSteps+1], uint64_t sums[boxNum][sumsLength],
 
 
 
-int main(int argc, char* argv[]) {
+// run the search from a starting state, where temp[] holds the boxes of 1, 2, 3, ...
 
-  // process command line arguments to create temp[]
-  std::vector<int> temp; 
-  if (argc == 2) {
-    for (int i=0; argv[1][i] != '\0'; i++) {
-       char letter = argv[1][i];
-       if ( '0' <= letter && letter <= '9' )   // if letter is a digit
-         temp.emplace_back(int(letter - '0'));
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::search(std::vector<int> temp) {
+
+  if (benchProbes) {
+    bench(benchProbes);
+    return;
+  }
+
+  best = startBest;    // current best max steps found, 0 unless --best
+  // best may be initialized to the value of a known valid solution to speed up
+  // the search. Do not initialize best above a known achievable value, or pruning
+  // may hide the true optimum.
+
+  increaseNeeded = false;
+  solutionCounts.clear();
+  kept.clear();
+  keptOf = 0;
+
+  // continue from a checkpoint
+  resumeUntil = 0;
+  if (!resumeFile.empty()) {
+    checkpoint::Fields fields;
+    if (!checkpoint::load(resumeFile, fields) || atoi(fields["boxNum"].c_str()) != boxNum
+        || (fields.count("rules") ? fields["rules"] : "puzzle") != rules::name(ruleSet)) {
+      std::cout << "  cannot resume from " << resumeFile << '\n' << std::flush;
+      return;
     }
-  } else if (argc > 2) {
-    std::cout << "bad user! bad!\n" << std::flush;
-    return 1;
+    std::vector<long long> path = checkpoint::split(fields["path"]);
+    int prefix = atoi(fields["prefix"].c_str());
+    temp.assign(path.begin(), path.begin() + prefix);
+    for (int i=prefix; i<(int)path.size(); i++)
+      resumePath[i+1] = (uint8_t)path[i];
+    resumeUntil = (int)path.size() + 1;
+    best = atoi(fields["best"].c_str());
+    increaseNeeded = atoi(fields["increaseNeeded"].c_str()) != 0;
+    std::cout << "  resuming at " << path.size()+1 << " with best " << best << '\n' << std::flush;
   }
+  prefixLength = (int)temp.size();
 
   // create state[] from temp[]
   int state[temp.size() + 1];
@@ -369,20 +983,10 @@ int main(int argc, char* argv[]) {
 
 
 
-  best = 0;    // current best max steps found
-  // best may be initialized to the value of a known valid solution to speed up
-  // the search. Do not initialize best above a known achievable value, or pruning
-  // may hide the true optimum.
-
-  increaseNeeded = false;
-
-
-
   /* initialize data structures */
 
-  uint8_t possibilities[maxSteps+1];   // possibilities[0] is never used
-  for (int i=1; i<=maxSteps; i++)
-    possibilities[i] = (1 << boxNum) - 1;   // each bit is a box
+  Possibilities possibilities;
+  fill(possibilities, true);
 
   uint64_t sums[boxNum][sumsLength];
   for (int i=0; i<boxNum; i++)
@@ -396,6 +1000,16 @@ int main(int argc, char* argv[]) {
   // initialize to state[]
   uint16_t n = sizeof(state)/sizeof(state[0]);
   initialize(possibilities, sums, n, state);
+  int dead = firstDead(possibilities, n);   // from now on, dead is kept up to date instead
+
+  if (estimateProbes) {
+    estimate(possibilities, sums, n, dead, estimateProbes);
+    return;
+  }
+  if (balanceTasks) {
+    balance(temp, balanceTasks);
+    return;
+  }
 
 
 
@@ -403,7 +1017,38 @@ int main(int argc, char* argv[]) {
   std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
   // do it
-  step(possibilities, sums, n);
+  std::unique_ptr<checkpoint::Timer> timer;
+  if (!checkpointFile.empty())
+    timer.reset(new checkpoint::Timer(checkpointSeconds, checkpointDue));
+  if (numThreads > 1 && !generateDepth) {
+    splitDepth = splitOption ? splitOption : prefixLength + 2*boxNum;
+    if (splitDepth <= prefixLength)
+      std::cout << "  --split " << splitDepth << " is not past the starting state, so only one thread searches\n" << std::flush;
+    pool = new WorkStealingPool(numThreads);
+    step(possibilities, sums, n, dead);   // the shallow levels only create tasks, so this returns quickly
+    pool->wait();
+    delete pool;
+    pool = nullptr;
+  } else {
+    step(possibilities, sums, n, dead);
+  }
+
+  timer.reset();
+  checkpointDue = false;
+  if (countAll)
+    reportCounts();
+  solutions.flush();
+  table.report();
+  if (useBounds)
+    bounds::report();
+
+#ifdef STATS
+  stats::collect();   // the pool's threads have ended, so their counters are already in
+  std::string about = "\"program\": \"boxes\", \"boxNum\": " + std::to_string(boxNum);
+  if (stats::dump(statsFile, about))
+    std::cout << "  wrote search statistics to " << statsFile << '\n' << std::flush;
+  stats::reset();
+#endif
 
   // stop timer
   long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
@@ -412,7 +1057,550 @@ int main(int argc, char* argv[]) {
   std::cout << "  time for " << static_cast<unsigned>(boxNum) << " boxes is " << duration_ms << " ms\n" << std::flush;
   if (increaseNeeded)   std::cout << "  increase maxSteps! Current search bound was too small.\n" << std::flush;
 
+}
+
+
+
+// Time the pieces of step() separately, for --bench. The states are the ones reached by
+//   random probes, each of which starts at 1 and puts n in a random allowed box until n
+//   cannot be placed. Each piece is timed reps times at each state, and the bytes are
+//   the parts of the arrays that each piece goes through (see bench.h).
+// Removing NEWsums a second time changes nothing, so the repeats of that piece do the
+//   same reads but find nothing left to remove.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::bench(int probes) {
+
+  const int reps = 64;
+  bench::Kernel copyKernel("copy possibilities");
+  bench::Kernel shiftKernel("NEWsums shift");
+  bench::Kernel clearKernel("remove NEWsums");
+  bench::Kernel lookKernel("look-ahead prune");
+
+  std::mt19937 random(1);   // the same probes every time
+  uint64_t states = 0;
+
+  for (int probe=0; probe<probes; probe++) {
+    std::vector<int> path;   // the boxes of 1, 2, ..., n-1
+    while (true) {
+
+      // rebuild the state of the probe (slow, but not timed)
+      uint16_t n = path.size() + 1;
+      if (n > maxSteps)
+        break;
+      int state[maxSteps+1];
+      state[0] = -1;
+      for (int i=0; i<(int)path.size(); i++)
+        state[i+1] = path[i];
+      Possibilities possibilities;
+      fill(possibilities, true);
+      uint64_t sums[boxNum][sumsLength] = {{0}};
+      boxes[0] = 0;
+      initialize(possibilities, sums, n, state);
+
+      // the boxes that step() would try, then pick one at random
+      uint8_t options = boxesOf(possibilities, n);
+      if (boxes[0] < boxNum)
+        options &= (uint8_t)((2 << boxes[0]) - 1);   // only the first empty box
+      if (!options)
+        break;
+      for (int pick = random() % __builtin_popcount(options); pick > 0; pick--)
+        options &= options - 1;
+      int box = __builtin_ctz(options);
+      int ndiv = n >> 6;
+      states++;
+
+      // the pieces of step()
+      Possibilities possibilitiesNew;
+#ifdef BIT_PLANES
+      double copyBytes = 2.0 * 8 * boxNum * (sumsLength - ((n+1) >> 6));
+      double clearBytes = 3.0 * 8 * (sumsLength - ndiv);
+#else
+      double copyBytes = 2.0 * (maxSteps - n);
+      double clearBytes = 8.0 * (sumsLength - ndiv) + 2.0 * (maxSteps + 1 - 64*ndiv);
+#endif
+      copyKernel.time(reps, copyBytes, [&]() {
+        copyPossibilities(possibilitiesNew, possibilities, n);
+        bench::keep(possibilitiesNew);
+      });
+
+      uint64_t NEWsums[sumsLength];
+      shiftKernel.time(reps, 3.0 * 8 * (sumsLength - ndiv), [&]() {
+        newSums(sums[box], n, NEWsums);
+        bench::keep(NEWsums);
+      });
+
+      clearKernel.time(reps, clearBytes, [&]() {
+        int dead = removeNewSums(possibilitiesNew, NEWsums, ndiv, box, maxSteps+1);
+        bench::keep(dead);
+      });
+
+      // the scan that the prune did at every step before dead was kept up to date
+      int dead = firstDead(possibilitiesNew, n+1);
+#ifdef BIT_PLANES
+      double lookBytes = 8.0 * boxNum * (((dead > maxSteps ? maxSteps : dead) >> 6) - ((n+1) >> 6) + 1);
+#else
+      double lookBytes = (dead > maxSteps ? maxSteps : dead) - n;
+#endif
+      lookKernel.time(reps, lookBytes, [&]() {
+        int dead = firstDead(possibilitiesNew, n+1);
+        bench::keep(dead);
+      });
+
+      path.push_back(box);
+    }
+  }
+
+  std::cout << "  benchmark for " << static_cast<unsigned>(boxNum) << " boxes: " << probes << " probes reached "
+            << states << " states, " << reps << " calls of each kernel per state\n";
+#ifdef BIT_PLANES
+  std::cout << "  layout BIT_PLANES\n";
+#else
+  std::cout << "  layout possibilities[n], simd " << simd::levelName(simd::Kernels<uint8_t>::level) << '\n';
+#endif
+  bench::report({&copyKernel, &shiftKernel, &clearKernel, &lookKernel});
+
+}
+
+
+
+// run Boxes<boxNum, SumRule, MultipleRule>::search() for the boxNum and rules given at run time
+
+template <class SumRule, class MultipleRule>
+void search(int boxNum, std::vector<int> temp) {
+  switch (boxNum) {
+    case 1: Boxes<1, SumRule, MultipleRule>::search(temp); break;
+    case 2: Boxes<2, SumRule, MultipleRule>::search(temp); break;
+    case 3: Boxes<3, SumRule, MultipleRule>::search(temp); break;
+    case 4: Boxes<4, SumRule, MultipleRule>::search(temp); break;
+    case 5: Boxes<5, SumRule, MultipleRule>::search(temp); break;
+    case 6: Boxes<6, SumRule, MultipleRule>::search(temp); break;
+    case 7: Boxes<7, SumRule, MultipleRule>::search(temp); break;
+    case 8: Boxes<8, SumRule, MultipleRule>::search(temp); break;
+  }
+}
+
+void search(int boxNum, std::vector<int> temp) {
+  switch (ruleSet) {
+    case rules::puzzle:  search<rules::SubsetSums, rules::Multiple<2> >(boxNum, temp); break;
+    case rules::schur:   search<rules::PairSums, rules::Multiple<2> >(boxNum, temp); break;
+    case rules::triples: search<rules::SubsetSums, rules::Multiple<3> >(boxNum, temp); break;
+  }
+}
+
+
+
+// Search 1 to 4 boxes with the rules of Schur's problem, for --checkSchur, and compare
+//   with the Schur numbers. 5 boxes (160) is past maxSteps. Returns false if any differ.
+
+bool checkSchur() {
+  const int schurNumbers[] = {1, 4, 13, 44};
+  ruleSet = rules::schur;
+  bool good = true;
+  std::string found;
+  for (int boxNum=1; boxNum<=4; boxNum++) {
+    search(boxNum, std::vector<int>());
+    found += " " + std::to_string(best.load());
+    if (best != schurNumbers[boxNum-1] || increaseNeeded)
+      good = false;
+  }
+  std::cout << "  Schur numbers found:" << found << (good ? ", as expected\n" : ", but they are 1 4 13 44!!\n") << std::flush;
+  return good;
+}
+
+
+
+// the digits of a comma-separated state such as 0,1,0,2,0,1
+
+std::vector<int> parseState(const char *text) {
+  std::vector<int> temp;
+  for (int i=0; text[i] != '\0'; i++) {
+     char letter = text[i];
+     if ( '0' <= letter && letter <= '9' )   // if letter is a digit
+       temp.emplace_back(int(letter - '0'));
+  }
+  return temp;
+}
+
+
+
+// Build the child of a step that puts n in box, which is what step() does before its
+//   recursive call (copying possibilities[] rather than using trail[]). Returns the
+//   child's dead.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+int Boxes<boxNum, SumRule, MultipleRule>::makeChild(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int dead, int box,
+                             Possibilities possibilitiesNew, uint64_t sumsNew[boxNum][sumsLength]) {
+
+  int ndiv = n >> 6;
+  copyPossibilities(possibilitiesNew, possibilities, n);
+  for (int i=0; i<boxNum; i++)
+    for (int j=0; j<sumsLength; j++)
+      sumsNew[i][j] = sums[i][j];
+
+  int j = MultipleRule::of(n);
+  if (j && j <= maxSteps) {
+    removeFrom(possibilitiesNew, j, box);
+    if (!boxesOf(possibilitiesNew, j) && j < dead)
+      dead = j;
+  }
+
+  uint64_t NEWsums[sumsLength];
+  newSums(sums[box], n, NEWsums);
+  dead = removeNewSums(possibilitiesNew, NEWsums, ndiv, box, dead);
+
+  for (int i = ndiv; i < sumsLength; i++)
+    sumsNew[box][i] = SumRule::add(sumsNew[box][i], NEWsums[i]);
+  sumsNew[box][ndiv] |= (uint64_t)1 << (n & 63);
+  return dead;
+}
+
+
+
+// Estimate the number of calls of step() and the time that the search would take, for
+//   --estimate. Each probe starts at the starting state and goes down to a leaf,
+//   choosing a random box at each level among the ones that step() would try, and the
+//   probes are added up as in estimate.h.
+// A node's time is the time to build all of its children, measured on the probe, so
+//   the estimate is calibrated on this computer. best stays at --best (default 0)
+//   instead of rising as solutions are found, so without --best, pruning is weaker
+//   than in the real search and the estimate is too big. Give --best about the answer
+//   expected (or the best known) to estimate the real search.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::estimate(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int dead, int probes) {
+
+  std::mt19937 random(1);   // the same probes every time
+  estimate::Mean nodes, seconds;
+  probe(possibilities, sums, n, dead, probes, random, nodes, seconds);
+
+  std::cout << "  estimate for " << static_cast<unsigned>(boxNum) << " boxes from " << probes
+            << " probes, with best at " << best << '\n';
+  estimate::report(nodes, seconds);
+
+}
+
+
+
+// Add probes starting at a state to nodes and seconds, for estimate() and balance().
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::probe(const Possibilities possibilities, const uint64_t sums[boxNum][sumsLength], uint16_t n, int dead, int probes,
+                          std::mt19937 &random, estimate::Mean &nodes, estimate::Mean &seconds) {
+
+  int bestNow = best;
+  uint8_t usedBoxes = boxes[0];
+
+  Possibilities possibilitiesLevel[2];
+  uint64_t sumsLevel[2][boxNum][sumsLength];
+
+  for (int probe=0; probe<probes; probe++) {
+
+    int now = 0;   // which of possibilitiesLevel[] and sumsLevel[] the probe is at
+    copyPossibilities(possibilitiesLevel[now], possibilities, 0);
+    for (int i=0; i<boxNum; i++)
+      for (int j=0; j<sumsLength; j++)
+        sumsLevel[now][i][j] = sums[i][j];
+    boxes[0] = usedBoxes;
+    uint16_t m = n;
+    int deadNow = dead;
+
+    double weight = 1;   // the estimated number of nodes at this level
+    double count = 1;
+    double time = 0;
+    while (true) {
+
+      // the same checks as step()
+      if ((deadNow > m && deadNow < bestNow+2) || m > maxSteps)
+        break;
+      uint8_t options = boxesOf(possibilitiesLevel[now], m);
+      if (boxes[0] < boxNum)
+        options &= (uint8_t)((2 << boxes[0]) - 1);   // only the first empty box
+      if (!options)
+        break;
+
+      // a random one of the children, which is built last so that it is kept
+      uint8_t chosen = options;
+      for (int pick = random() % __builtin_popcount(options); pick > 0; pick--)
+        chosen &= chosen - 1;
+      chosen &= -chosen;
+      int box = __builtin_ctz(chosen);
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      int deadNew = deadNow;
+      for (uint8_t others = options & ~chosen; others; others &= others - 1)
+        deadNew = makeChild(possibilitiesLevel[now], sumsLevel[now], m, deadNow, __builtin_ctz(others),
+                            possibilitiesLevel[!now], sumsLevel[!now]);
+      deadNew = makeChild(possibilitiesLevel[now], sumsLevel[now], m, deadNow, box,
+                          possibilitiesLevel[!now], sumsLevel[!now]);
+      time += weight * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      weight *= __builtin_popcount(options);
+      count += weight;
+      boxes[m] = box;
+      if (box == boxes[0])
+        boxes[0] = box+1;
+      now = !now;
+      m++;
+      deadNow = deadNew;
+    }
+
+    nodes.add(count);
+    seconds.add(time);
+  }
+
+  boxes[0] = usedBoxes;
+
+}
+
+
+
+// Set up possibilities[], sums[], and boxes[] for the starting state temp[], the same
+//   way that search() does. Returns dead.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+int Boxes<boxNum, SumRule, MultipleRule>::setUp(const std::vector<int> &temp, Possibilities possibilities, uint64_t sums[boxNum][sumsLength]) {
+
+  int state[maxSteps+1];
+  state[0] = -1;
+  for (int i=0; i<(int)temp.size(); i++)
+    state[i+1] = temp[i];
+
+  fill(possibilities, true);
+  for (int i=0; i<boxNum; i++)
+    for (int j=0; j<sumsLength; j++)
+      sums[i][j] = 0;
+  boxes[0] = 0;
+
+  uint16_t n = temp.size() + 1;
+  initialize(possibilities, sums, n, state);
+  return firstDead(possibilities, n);
+}
+
+
+
+// Split the search below temp[] into tasks that are each estimated to take no more than
+//   1/tasks of the total time, for --balance. This replaces cutting at one depth, where
+//   some tasks finish at once and a few take almost all of the time.
+// The most expensive task is repeatedly replaced by its children (the boxes that step()
+//   would try for the next number), each of which is costed by balanceProbes probes
+//   (see probe()). A task that step() would prune, or whose next number cannot be
+//   placed, has no children and is kept as it is.
+// The tasks are put in generated[] most expensive first, so that workers, which claim
+//   tasks in order of name, start the long ones first.
+
+template <uint8_t boxNum, class SumRule, class MultipleRule>
+void Boxes<boxNum, SumRule, MultipleRule>::balance(const std::vector<int> &temp, int tasks) {
+
+  struct Task {
+    std::vector<int> path;   // the boxes of 1, 2, ...
+    double cost;             // estimated seconds
+    bool operator<(const Task &other) const { return cost < other.cost; }
+  };
+
+  std::mt19937 random(1);   // the same tasks every time
+  Possibilities possibilities;
+  uint64_t sums[boxNum][sumsLength];
+
+  auto cost = [&](const std::vector<int> &path) {
+    int dead = setUp(path, possibilities, sums);
+    estimate::Mean nodes, seconds;
+    probe(possibilities, sums, path.size() + 1, dead, balanceProbes, random, nodes, seconds);
+    return seconds.mean;
+  };
+
+  std::priority_queue<Task> frontier;   // the most expensive on top
+  std::vector<Task> unsplittable;
+  Task first = {temp, cost(temp)};
+  frontier.push(first);
+  double total = first.cost;
+
+  // split until the most expensive task is no more than its share of the total
+  while (!frontier.empty() && frontier.top().cost > total / tasks) {
+    Task task = frontier.top();
+    frontier.pop();
+    total -= task.cost;
+
+    // the children, found the same way as in step()
+    int dead = setUp(task.path, possibilities, sums);
+    uint16_t n = task.path.size() + 1;
+    uint8_t options = 0;
+    if (!(dead > n && dead < best+2) && n <= maxSteps) {
+      options = boxesOf(possibilities, n);
+      if (boxes[0] < boxNum)
+        options &= (uint8_t)((2 << boxes[0]) - 1);   // only the first empty box
+    }
+    if (!options) {
+      unsplittable.push_back(task);
+      continue;
+    }
+
+    for (; options; options &= options - 1) {
+      Task child = {task.path, 0};
+      child.path.push_back(__builtin_ctz(options));
+      child.cost = cost(child.path);
+      total += child.cost;
+      frontier.push(child);
+    }
+  }
+
+  std::vector<Task> all = unsplittable;
+  for (; !frontier.empty(); frontier.pop())
+    all.push_back(frontier.top());
+  std::sort(all.begin(), all.end(), [](const Task &a, const Task &b) { return a.cost > b.cost; });
+
+  for (size_t i=0; i<all.size(); i++) {
+    std::string state;
+    for (size_t j=0; j<all[i].path.size(); j++)
+      state += std::to_string(all[i].path[j]) + (j+1 < all[i].path.size() ? "," : "");
+    generated.push_back(state);
+  }
+
+  std::cout << "  " << all.size() << " tasks with an estimated " << estimate::duration(total) << " in total"
+            << ", from " << estimate::duration(all.empty() ? 0 : all.back().cost)
+            << " to " << estimate::duration(all.empty() ? 0 : all[0].cost) << " each\n" << std::flush;
+
+}
+
+
+
+int main(int argc, char* argv[]) {
+
+  // process command line arguments to create temp[]
+  std::vector<int> temp; 
+  int boxNum = 4;
+  bool haveState = false;
+  const char *generateDir = nullptr;
+  const char *workerDir = nullptr;
+  int staleSeconds = 600;
+  bool checkSchur = false;
+  for (int a=1; a<argc; a++) {
+    if (!strcmp(argv[a], "--boxes") && a+1 < argc) {
+      boxNum = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--threads") && a+1 < argc) {
+      numThreads = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--split") && a+1 < argc) {
+      splitOption = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--generate") && a+2 < argc) {
+      generateDir = argv[++a];
+      generateDepth = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--worker") && a+1 < argc) {
+      workerDir = argv[++a];
+    } else if (!strcmp(argv[a], "--stale") && a+1 < argc) {
+      staleSeconds = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--checkpoint") && a+1 < argc) {
+      checkpointFile = argv[++a];
+    } else if (!strcmp(argv[a], "--every") && a+1 < argc) {
+      checkpointSeconds = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--resume") && a+1 < argc) {
+      resumeFile = argv[++a];
+    } else if (!strcmp(argv[a], "--bench") && a+1 < argc) {
+      benchProbes = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--balance") && a+2 < argc) {
+      generateDir = argv[++a];
+      balanceTasks = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--estimate") && a+1 < argc) {
+      estimateProbes = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--best") && a+1 < argc) {
+      startBest = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--solutions") && a+1 < argc) {
+      if (!solutions.open(argv[++a])) {
+        std::cout << "cannot write " << argv[a] << '\n' << std::flush;
+        return 1;
+      }
+    } else if (!strcmp(argv[a], "--bound")) {
+      useBounds = true;
+    } else if (!strcmp(argv[a], "--rules") && a+1 < argc) {
+      if (!rules::parse(argv[++a], ruleSet)) {
+        std::cout << "--rules must be puzzle, schur, or triples\n" << std::flush;
+        return 1;
+      }
+    } else if (!strcmp(argv[a], "--checkSchur")) {
+      checkSchur = true;
+    } else if (!strcmp(argv[a], "--countAll")) {
+      countAll = true;
+    } else if (!strcmp(argv[a], "--sample") && a+1 < argc) {
+      sampleSize = strtoul(argv[++a], nullptr, 10);
+    } else if (!strcmp(argv[a], "--table") && a+1 < argc) {
+      if (!table.resize(atoi(argv[++a]))) {
+        std::cout << "cannot allocate " << argv[a] << " MB for --table\n" << std::flush;
+        return 1;
+      }
+    } else if (!strcmp(argv[a], "--replace") && a+1 < argc) {
+      transposition::Policy policy;
+      if (!transposition::parsePolicy(argv[++a], policy)) {
+        std::cout << "--replace must be always or bigger\n" << std::flush;
+        return 1;
+      }
+      table.setPolicy(policy);
+    } else if (!strcmp(argv[a], "--tableDepth") && a+1 < argc) {
+      tableDepth = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--stats") && a+1 < argc) {
+      statsFile = argv[++a];
+#ifndef STATS
+      std::cout << "  --stats does nothing unless STATS is defined\n" << std::flush;
+#endif
+    } else if (!strcmp(argv[a], "--simd") && a+1 < argc) {
+      simd::Level level;
+      if (!simd::parseLevel(argv[++a], level)) {
+        std::cout << "bad user! bad!\n" << std::flush;
+        return 1;
+      }
+      if (level > simd::cpuLevel()) {
+        std::cout << "--simd " << argv[a] << " needs " << simd::levelName(level) << ", but this CPU only has "
+                  << simd::levelName(simd::cpuLevel()) << '\n' << std::flush;
+        return 1;
+      }
+      simd::Kernels<uint8_t>::use(level);
+    } else if (argv[a][0] != '-' && !haveState) {
+      haveState = true;
+      temp = parseState(argv[a]);
+    } else {
+      std::cout << "bad user! bad!\n" << std::flush;
+      return 1;
+    }
+  }
+
+
+  if (boxNum < 1 || boxNum > maxBoxNum) {
+    std::cout << "--boxes must be from 1 to " << (int)maxBoxNum << '\n' << std::flush;
+    return 1;
+  }
+  if (!tableDepth)
+    tableDepth = 2*boxNum;
+  if (useBounds && (ruleSet != rules::puzzle || checkSchur)) {
+    std::cout << "--bound only works with --rules puzzle\n" << std::flush;
+    return 1;
+  }
+  if (countAll && (table.enabled() || !checkpointFile.empty() || !resumeFile.empty())) {
+    std::cout << "--countAll cannot be combined with --table (it skips equal solutions) or checkpoints\n" << std::flush;
+    return 1;
+  }
+  if (checkSchur)
+    return ::checkSchur() ? 0 : 1;
+
+
+  if ((!checkpointFile.empty() || !resumeFile.empty()) && (numThreads > 1 || workerDir || generateDir)) {
+    std::cout << "checkpoints only work for a plain single-threaded search\n" << std::flush;
+    return 1;
+  }
+
+
+  if (workerDir) {
+    jobFolder::runWorker(workerDir, staleSeconds, [boxNum](const std::string &content) {
+      search(boxNum, parseState(content.c_str()));
+    });
+    return 0;
+  }
+
+
+  search(boxNum, temp);
+
+  if (generateDir) {
+    int written = jobFolder::writeTasks(generateDir, generated);
+    std::cout << "  wrote " << written << " tasks to " << generateDir << "/jobs\n" << std::flush;
+  }
 
 
   return 0;
-}
\ No newline at end of file
+}
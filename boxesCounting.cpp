@@ -23,21 +23,49 @@
 
   g++ -O3 -std=c++11 boxesCounting.cpp
   ./a.out
-
-  For boxNumAll=14 (or 12 if not using the subsequent-filling trick),
-  on my macOS or Ubuntu, I have to first run
-    ulimit -s 16384
-  before running a.out, else I get a segmentation fault due to a stack overflow.
-  This doubles the default stack size limit for the terminal for as long as it is open.
-  For boxNumAll=15...
-    ulimit -s 65532
-  which is the highest macOS will go. Linux can keep going! For boxNumAll=16, 128 MiB works...
-    ulimit -s 131072
-
-  On Windows, I need the following to increase a tiny (1 MiB??) stack size limit...
-    g++ -O3 -std=c++11 "-Wl,--stack,16777216" boxesCounting.cpp
-  For 128 MiB...
-    g++ -O3 -std=c++11 "-Wl,--stack,134217728" boxesCounting.cpp
+  ./a.out --boxes 5 --counting 0,0,0,1,1 --minStart 0,0,0,8,0
+  --boxes sets boxNumAll (default 16, at most maxBoxNumAll=16), and --counting,
+    --minStart, and --maxStart set isCounting[], minStart[], and maxStart[] for that
+    run (see the settings below).
+
+  A starting state can be given as a comma-separated list of the box tried at each
+    level of the recursion, e.g. ./a.out 0,1,0,2,0,1
+    Unlike boxes.cpp, a level can place a whole counting-box interval, so a state is
+    not simply the box of 1, 2, 3, ... Only use states written by --generate.
+
+  Other options, as in boxes.cpp (compile with -pthread for --threads and --sweep)...
+    --threads 64       search on 64 threads; the starts of counting boxes also become tasks
+    --split 12         branches above depth 12 become tasks for the threads
+                         (default twice the boxes that are not counting boxes)
+    --generate DIR 12, --balance DIR 500, --worker DIR, --stale 600
+    --checkpoint FILE, --every 600, --resume FILE
+    --simd LEVEL, --bench 200, --estimate 1000, --best 156, --stats FILE, --solutions FILE
+    --bound            also prune with the units bound of bounds.h, for the boxes
+                         that are not counting boxes that have not started
+    --table 256, --replace POLICY, --tableDepth 10
+                       as in boxes.cpp, but the key has every number after n, and
+                         only subtrees that printed nothing are stored (see stateKey())
+    --forced           put n without branching in a box that can take no later number
+                         (see force()); each new best then lists these for recover.cpp
+    --sweep FILE       search every layout of FILE, sharing best (see sweep()), where
+                         each line is the lists of --counting, --minStart, and,
+                         optionally, --maxStart, such as "0,0,0,0,1,1  0,0,0,0,27,0"
+  Workers, --resume, and tasks need the same --boxes, --counting, --minStart,
+    --maxStart, and --forced they were written with. Checkpoints do not work with
+    --threads, and --sweep does not work with --table, checkpoints, a starting state,
+    or the modes that do not search. The README has what each of these did to the
+    time on my computer.
+
+  The search no longer recurses. The copies of possibilities[] and sums[] for each
+    level are kept on the heap (see FrameArena), so there is no need for
+    ulimit -s or for Windows "-Wl,--stack,..." flags, up to the 16 boxes it is
+    compiled for. The sums of a counting box are kept as a few intervals instead of
+    a row of sums[] (see sumIntervals.h).
+  Uncommenting "#define STATS" counts frames, prunes, leaves, children, and skipped
+    symmetric boxes at each depth (the numbers placed, so n-1 here). "#define
+    UNDO_TRAIL" undoes the changes to one possibilities[] instead of copying it, which
+    was slower, and "#define BIT_PLANES" keeps a copy-on-write bitset of numbers for
+    each box, which was faster, but --simd then does nothing. They cannot be combined.
 
 
   To print ALL of the best solutions, there are two commented lines of code to change.
@@ -45,21 +73,52 @@
 
   Technical ideas to speed things up...
    - Since now counting boxes are a thing, consider limiting the non-initial pruning???
-   - Should I make sums[] smaller since some counting boxes can never be "reactivated" after counting?
-   - Use an array of pointers to std::array so that only a small part of the sums 
-     array can be deep copied.
-     This slows things down for small boxNumAll, but, if larger,
-     data structures are quite huge and should probably be on the heap anyway?
+   - sums[] is now an array of pointers to rows (see Frame), so only the one row that
+     a step changes is deep copied. BIT_PLANES does the same for possibilities[].
 */
 
 
+// Count frames, prunes, leaves, and skipped symmetric boxes at each depth of the
+//   search, and write them to --stats (default stats.json). See searchStats.h.
+//#define STATS
+
 #include <iostream>
 #include <chrono>
 #include <ctime>
 #include <vector>
-
-uint32_t best;
-bool increaseNeeded;
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <atomic>
+#include <memory>
+#include <deque>
+#include <random>
+#include <queue>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "jobFolder.h"
+#include "checkpoint.h"
+#include "simdKernels.h"
+#include "bench.h"
+#include "searchStats.h"
+#include "estimate.h"
+#include "solutionStream.h"
+#include "transposition.h"
+#include "bounds.h"
+#include "sumIntervals.h"
+#include "workStealingPool.h"
+
+std::atomic<uint32_t> best;       // shared by the threads of --sweep; relaxed loads of this compile to plain loads on x86
+thread_local bool increaseNeeded;
+std::mutex printMutex;            // new bests are printed one at a time
+
+solutionStream::Writer solutions;   // if opened, new bests are written here instead of printed (see --solutions)
 
 
 
@@ -69,25 +128,35 @@ bool increaseNeeded;
 ////////////////////////////////////
 
 /*
-  Set number of boxes
-
-  not greater than 8 while possType is uint8_t
-  uint16_t is only about 2 percent slower
-
-  not greater than 14 while nType is uint16_t
-  not greater than 16 while possType is uint16_t
+  Set number of boxes with --boxes (default 16)
+
+  The search is a template, Counting<boxNumAll, possType, nType>, compiled once for
+    each boxNumAll up to maxBoxNumAll, so maxSteps and sumsLength are still constants.
+    search() below picks the smallest types that work...
+      possType is uint8_t for up to 8 boxes (uint16_t is only about 2 percent slower)
+      nType is uint16_t for up to 14 boxes
+      possType is uint16_t and nType is uint32_t for 15 and 16 boxes
+  More than 16 boxes would need possType to be uint32_t, and NEWsums[] in nextChild()
+    would no longer fit on the stack (the RAM for each level of the search grows as 2^boxNumAll).
 */
 
-const uint8_t boxNumAll = 16;
+const uint8_t maxBoxNumAll = 16;
+
+//#define UNDO_TRAIL     // uncomment to undo changes to one possibilities[] instead of copying it at each step
+//#define BIT_PLANES     // uncomment to keep a bitset of numbers for each box instead of possibilities[n] (see Frame)
 
-#define possType uint16_t
-#define nType uint32_t
+#if defined(BIT_PLANES) && defined(UNDO_TRAIL)
+#error "BIT_PLANES and UNDO_TRAIL cannot be used together"
+#endif
 
 
 
 /*
   Set counting boxes.
   Set min starting value in the boxes.
+  These are for 16 boxes. For fewer boxes, the first boxNumAll of each are used,
+    or give --counting and --minStart (and --maxStart) as comma-separated lists,
+    such as --boxes 5 --counting 0,0,0,1,1 --minStart 0,0,0,8,0
   The min of a non-counting box is ignored.
   Note that counting boxes will never start at n<5.
 
@@ -98,14 +167,15 @@ const uint8_t boxNumAll = 16;
   differ only by swapping counting-box labels.
 */
 
-bool isCounting[boxNumAll]         = {false, false, false, true, true, true, true, true, true, true, true, true,  true,  true,  true, true};
-const uint32_t minStart[boxNumAll] = {    0,     0,     0,   13,   37,    0,  157,  329,  659, 1329, 2695, 5404, 10893, 21786, 43730,    0};
+thread_local bool isCounting[maxBoxNumAll]   = {false, false, false, true, true, true, true, true, true, true, true, true,  true,  true,  true, true};
+thread_local uint32_t minStart[maxBoxNumAll] = {    0,     0,     0,   13,   37,    0,  157,  329,  659, 1329, 2695, 5404, 10893, 21786, 43730,    0};
 
 
 
 /*
   Use the following to be able to "pick up where you left off".
   Else, all should be set to max.
+  (--checkpoint and --resume, described at the top, do this exactly.)
   Note that it doesn't exactly pick up where you left off, and,
     especially for later boxes, will have to do some repeated calculation.
     To test the time for repeated calculations, set the maxStart below the minStart.
@@ -121,8 +191,8 @@ const uint32_t minStart[boxNumAll] = {    0,     0,     0,   13,   37,    0,  15
   not an independent per-box permission check.
 */
 
-const nType max =  ~( (nType)0 );
-const nType maxStart[boxNumAll]    = {  max,   max,   max,  max,  max,  max,  max,  max,  max,  max,  max,  max,   max,   max, 43730,  max};
+const uint32_t max =  ~( (uint32_t)0 );
+thread_local uint32_t maxStart[maxBoxNumAll] = {  max,   max,   max,  max,  max,  max,  max,  max,  max,  max,  max,  max,   max,   max, 43730,  max};
 
 
 ////////////////////////////////////
@@ -131,27 +201,175 @@ const nType maxStart[boxNumAll]    = {  max,   max,   max,  max,  max,  max,  ma
 
 
 
-/*
-  found max number will go up to maxSteps-1
-*/
+//optional. Gives useful information to print
+thread_local uint64_t counts[maxBoxNumAll] = {0};
 
-const nType maxSteps = (nType) 3 << boxNumAll;   // this seems safe
 
 
+// the box tried at each level of the recursion, for --generate
+thread_local int *path = nullptr;   // maxSteps+1 long (see initRoot())
 
+std::vector<int> prefix;                 // starting state: the box to use at each of the first levels
+int generateDepth = 0;                   // if not 0, collect the states at this depth instead of searching
+std::vector<std::string> generated;
 
-const nType sumsLength = ( maxSteps>>6 ) + 1;
+std::atomic<bool> checkpointDue(false);  // set by the checkpoint timer
+int checkpointSeconds = 600;
+std::string checkpointFile;
+std::string resumeFile;
+std::vector<int> resumePath;             // path[] of the checkpoint being resumed
+thread_local int resumeDepth = 0;        // resuming while at depth < resumeDepth
 
-//optional. Gives useful information to print
-uint64_t counts[boxNumAll] = {0};
+int benchProbes = 0;                     // if not 0, time the pieces of the search instead of searching
+
+std::string statsFile = "stats.json";    // where STATS builds write the counters
+
+bool forcing = false;                    // place n without branching when it fits a closed box (see --forced)
+thread_local uint32_t *forcedN = nullptr;   // by depth, n at a forced level
+thread_local uint32_t *forcedOthers = nullptr;   // by depth, the other boxes n could have gone in, or 0 if not forced
+thread_local uint64_t forcedCount = 0;   // how many levels were forced
+
+bool useBounds = false;                  // prune with the bound of bounds.h too (see --bound)
 
+transposition::Table table;              // subtrees already searched, if --table is given
+int tableDepth = 0;                      // levels below the starting state that use the table (see --table)
+int tableUntil = 0;                      // the depth where that stops
+thread_local uint64_t frameCount = 0;    // frames entered, for the sizes of subtrees
+thread_local uint64_t bestsFound = 0;    // new bests printed, to see if a subtree found any
 
+int estimateProbes = 0;                  // if not 0, estimate the size of the search instead of searching
+uint32_t startBest = 0;                  // what best starts at (see --best)
 
-std::vector<nType> boxes[boxNumAll];       // array of empty vectors
+int balanceTasks = 0;                    // if not 0, split the search into tasks for --balance
+int balanceProbes = 200;                 // probes used to estimate the cost of each task for --balance
 
+int numThreads = 0;                      // threads for --sweep (0 for one per core) or for the search
+thread_local int sweepIndex = -1;        // the configuration of --sweep that this thread is searching, or -1
+thread_local uint32_t bestFound = 0;     // the last best printed by this thread, for --sweep
 
+WorkStealingPool *pool = nullptr;        // only used if --threads is more than 1 (and not for --sweep)
+int splitDepth = 0;                      // every branch above this depth becomes a pool task (see --split)
+thread_local const int *taskPath = nullptr;   // the path from the root to the subtree of this thread's pool task
+thread_local int taskDepth = 0;          // the length of taskPath[], whose levels are only replayed
 
-void printBoxes() {
+
+
+// the settings of the counting boxes, which are thread_local for --sweep, so a pool task
+//   takes them along to whichever thread runs it
+
+struct Layout {
+  bool isCounting[maxBoxNumAll];
+  uint32_t minStart[maxBoxNumAll];
+  uint32_t maxStart[maxBoxNumAll];
+  Layout() {   // the settings of this thread
+    for (int i=0; i<maxBoxNumAll; i++) {
+      isCounting[i] = ::isCounting[i];
+      minStart[i] = ::minStart[i];
+      maxStart[i] = ::maxStart[i];
+    }
+  }
+  void use() const {
+    for (int i=0; i<maxBoxNumAll; i++) {
+      ::isCounting[i] = isCounting[i];
+      ::minStart[i] = minStart[i];
+      ::maxStart[i] = maxStart[i];
+    }
+  }
+};
+
+// What the pool tasks counted, which each task adds its thread's counts to when it is
+//   done, for search() to print. best is already shared.
+std::mutex totalsMutex;
+uint64_t taskCounts[maxBoxNumAll];
+uint64_t taskForcedCount;
+bool taskIncreaseNeeded;
+
+void addTaskTotals() {
+  std::lock_guard<std::mutex> lock(totalsMutex);
+  for (int i=0; i<maxBoxNumAll; i++) {
+    taskCounts[i] += counts[i];
+    counts[i] = 0;
+  }
+  taskForcedCount += forcedCount;
+  forcedCount = 0;
+  taskIncreaseNeeded = taskIncreaseNeeded || increaseNeeded;
+  increaseNeeded = false;
+}
+
+
+
+inline uint32_t firstAllowed(uint32_t countStart) {
+    return ((3*countStart - 5) * countStart) >> 1;    // valid for countStart > 4
+}
+
+
+
+// the search for boxNumAll boxes
+
+template <uint8_t boxNumAll, class possType, class nType>
+struct Counting {
+
+  /*
+    found max number will go up to maxSteps-1
+  */
+
+  static const nType maxSteps = (nType) 3 << boxNumAll;   // this seems safe
+
+  static const nType sumsLength = ( maxSteps>>6 ) + 1;
+
+  static thread_local std::vector<nType> *boxes;   // boxNumAll vectors of this thread (see initRoot())
+
+  static thread_local nType *trailTop;   // the end of the trail (UNDO_TRAIL only)
+
+  struct Frame;
+  class FrameArena;
+
+  static void printBoxes();
+  static void writeSolution(uint32_t max);
+  static possType boxesOf(const Frame &f, nType n);
+  static nType firstDead(const Frame &f, nType from);
+#ifdef BIT_PLANES
+  static void clearRange(uint64_t row[sumsLength], uint32_t from, uint32_t to);
+  static void subsequentFill(const sumIntervals::List &sums, sumIntervals::List &sumsNew, uint64_t planeNew[sumsLength], nType n0, nType len);
+#else
+  static void removeBox(possType possibilitiesNew[maxSteps+1], nType j, possType bit, nType *&top);
+  static void subsequentFill(const sumIntervals::List &sums, sumIntervals::List &sumsNew, possType possibilitiesNew[maxSteps+1], nType n0, nType len, possType bit, nType *&top);
+#endif
+  static void writeCheckpoint(int depth);
+  static possType openBoxes(const Frame &f, possType candidates, uint32_t from, uint32_t to);
+  static void force(Frame &f, int depth);
+  static void printForced(int depth);
+  static uint64_t stateKey(const Frame &f);
+  static void frameDone(const Frame &f);
+  static bool enterFrame(Frame &f, int depth);
+  static bool nextChild(Frame &f, Frame &child, int depth);
+  static void childReturned(Frame &f);
+  static bool splits(const Frame &f, int depth);
+  static void spawn(int depth);
+  static void runTask(const std::vector<int> &taskPathOfTask);
+  static void run(FrameArena &arena, int base);
+  static void initRoot(FrameArena &arena);
+  static void search();
+  static void bench(int probes);
+  static void probe(FrameArena &arena, int probes, std::mt19937 &random, estimate::Mean &frames, estimate::Mean &seconds);
+  static void estimate(int probes);
+  static void balance(int tasks);
+
+};
+
+template <uint8_t boxNumAll, class possType, class nType>
+const nType Counting<boxNumAll, possType, nType>::maxSteps;
+template <uint8_t boxNumAll, class possType, class nType>
+const nType Counting<boxNumAll, possType, nType>::sumsLength;
+template <uint8_t boxNumAll, class possType, class nType>
+thread_local std::vector<nType> *Counting<boxNumAll, possType, nType>::boxes = nullptr;
+template <uint8_t boxNumAll, class possType, class nType>
+thread_local nType *Counting<boxNumAll, possType, nType>::trailTop = nullptr;
+
+
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::printBoxes() {
 
     std::cout << "[";
 
@@ -175,85 +393,489 @@ void printBoxes() {
 
 
 
-inline uint32_t firstAllowed(uint32_t countStart) {
-    return ((3*countStart - 5) * countStart) >> 1;    // valid for countStart > 4
+// write boxes[] to solutions as runs of consecutive numbers in the same box
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::writeSolution(uint32_t max) {
+
+    std::vector<solutionStream::Run> runs;
+    for (int j=0; j<boxNumAll; j++) {
+      for (size_t i=0; i < boxes[j].size(); i++) {
+        if (boxes[j][i] == 0)   // [a, 0, b] is the interval a to b
+          runs.back().last = boxes[j][++i];
+        else {
+          solutionStream::Run run = {j, boxes[j][i], boxes[j][i]};
+          runs.push_back(run);
+        }
+      }
+    }
+
+    // in order, with the neighboring runs of the same box joined
+    std::sort(runs.begin(), runs.end(), [](const solutionStream::Run &a, const solutionStream::Run &b) {
+      return a.first < b.first;
+    });
+    size_t joined = 0;
+    for (size_t i=0; i < runs.size(); i++) {
+      if (joined && runs[joined-1].box == runs[i].box && runs[joined-1].last + 1 == runs[i].first)
+        runs[joined-1].last = runs[i].last;
+      else
+        runs[joined++] = runs[i];
+    }
+    runs.resize(joined);
+
+    solutions.write(max, boxNumAll, runs);
+
 }
 
 
 
-// updates sums and possibilities when doing a subsequent fill
-void subsequentFill(uint64_t sumsNew[sumsLength], possType possibilitiesNew[maxSteps+1], nType n0, nType len, possType mask) {
+#ifndef BIT_PLANES
 
-    for (nType n = n0; n < n0+len; n++) {
+// Remove box (bit is 1<<box) from possibilitiesNew[j].
+// For UNDO_TRAIL, j is written to the end of the trail, top, if the box was there to remove.
+template <uint8_t boxNumAll, class possType, class nType>
+inline void Counting<boxNumAll, possType, nType>::removeBox(possType possibilitiesNew[maxSteps+1], nType j, possType bit, nType *&top) {
+#ifdef UNDO_TRAIL
+  *top = j;
+  top += (possibilitiesNew[j] & bit) != 0;
+#else
+  (void)top;
+#endif
+  possibilitiesNew[j] &= ~bit;
+}
 
-        uint64_t sums[sumsLength];
-        for (int j=0; j<sumsLength; j++)
-          sums[j] = sumsNew[j];
+#else
 
-        // remove 2*n from possibilitiesNew
+// remove the numbers from through to (at most maxSteps) from a row of possibilities
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::clearRange(uint64_t row[sumsLength], uint32_t from, uint32_t to) {
+  if (to > maxSteps)
+    to = maxSteps;
+  if (from > to)
+    return;
+  uint32_t first = from >> 6;
+  uint32_t last = to >> 6;
+  uint64_t low = ~((uint64_t)0) << (from & 63);         // from onwards
+  uint64_t high = ~((uint64_t)0) >> (63 - (to & 63));   // through to
+  if (first == last) {
+    row[first] &= ~(low & high);
+    return;
+  }
+  row[first] &= ~low;
+  for (uint32_t i = first+1; i < last; i++)
+    row[i] = 0;
+  row[last] &= ~high;
+}
+
+#endif
+
+
+
+// updates the sums of a counting box (as intervals, see sumIntervals.h) and possibilities
+//   when doing a subsequent fill of n0 through n0+len-1
+// Possibilities only matter from the child's n, n0+len, onwards, so the whole interval
+//   is added to the sums at once, and the sums that are new are removed from there,
+//   along with 2*n for each n.
+template <uint8_t boxNumAll, class possType, class nType>
+#ifdef BIT_PLANES
+void Counting<boxNumAll, possType, nType>::subsequentFill(const sumIntervals::List &sums, sumIntervals::List &sumsNew, uint64_t planeNew[sumsLength], nType n0, nType len) {
+#else
+void Counting<boxNumAll, possType, nType>::subsequentFill(const sumIntervals::List &sums, sumIntervals::List &sumsNew, possType possibilitiesNew[maxSteps+1], nType n0, nType len, possType bit, nType *&top) {
+#endif
+
+    sumIntervals::addRun(sums, n0, n0+len-1, maxSteps, sumsNew);
+
+    // remove 2*n from possibilitiesNew
+    for (nType n = n0; n < n0+len; n++) {
         uint32_t j = (uint32_t) n << 1;
-        if (j <= maxSteps)
-          possibilitiesNew[j] &= mask;  // remove from possibilities
+        if (j > maxSteps)
+          break;
+#ifdef BIT_PLANES
+        planeNew[j >> 6] &= ~((uint64_t)1 << (j & 63));
+#else
+        removeBox(possibilitiesNew, j, bit, top);
+#endif
+    }
 
-        // these should probably be passed in as function parameters
-        int nmod = n & 63;   // n%64
-        nType ndiv = n >> 6; // n/64
+    // remove the NEWsums (sumsNew but not sums) from possibilitiesNew
+    // The old sums were already removed when they became sums.
+    sumIntervals::forEachNew(sumsNew, sums, n0+len, [&](uint32_t first, uint32_t last) {
+#if defined(BIT_PLANES)
+        clearRange(planeNew, first, last);
+#elif defined(UNDO_TRAIL)
+        for (uint32_t j = first; j <= last; j++)
+          removeBox(possibilitiesNew, j, bit, top);
+#else
+        possType mask = ~bit;
+        for (uint32_t j = first; j <= last; j++)
+          possibilitiesNew[j] &= mask;
+#endif
+    });
 
-        // remove sums from possibilitiesNew and update sumsNew
-        for (int i=0; i<sumsLength; i++) {         // i represents 64 possible sums
-          uint64_t temp = sums[i];
+}
 
-          // Basically, bit shift sums[] by n to get the new sums.
-          // Tricky since sums[] is uint64_t, so sums come in groups of 64
-          if (i + ndiv < sumsLength)
-            sumsNew[i + ndiv] |= (temp << nmod);
-          if (i + ndiv + 1 < sumsLength  && nmod)
-          // nmod=0 needs to handled separately to prevent annoyingly-undefined behavior of right bitshift, hence the &&nmod
-            sumsNew[i + ndiv + 1] |= (temp >> (64 - nmod));
 
-          while(temp) {
-            int k = __builtin_ctzll( temp );       // count trailing zeros
-            uint32_t j = k + (i << 6) + (uint32_t)n;   // k + (i<<6) is the sum being added to
-            if (j > maxSteps)
-              goto endloops;
-            possibilitiesNew[j] &= mask;         // remove from possibilitiesNew[]
-            //sumsNew[j >> 6] |= ((uint64_t)1 << (j & 63));  // add to sumsNew[]
-            temp -= ((uint64_t)1 << k);
-          }
-        }
+/*
+  Forced placements, for --forced.
+
+  Call a box closed if it is not a counting box, it already has numbers, and no number
+    after n that the search could still reach can go in it. Then, if n can go in a
+    closed box, putting n there is at least as good as putting it in any other
+    non-counting box. The closed box never gets another number, and every other box
+    keeps all of its possibilities, so whatever could be placed after putting n in
+    another box can still be placed. So only the closed box (and any counting box,
+    which would place a whole interval instead) is tried, and the search still finds
+    the same best. The reach is dead, except that an empty counting box can still
+    take an interval [k, 2k-1] for some k before dead, after which the search can get
+    to the first number after 2*(dead-1) that cannot go in any box, and so on for
+    each empty counting box.
+  This keeps applying while n, n+1, ... each fit a closed box, so whole intervals and
+    groups of numbers are placed without branching, and closed boxes mostly appear
+    after the early boxes fill up, which is higher in the tree than single forced
+    numbers near the leaves.
+  The solutions with n in one of the other boxes are then skipped, so, with each new
+    best, every forced level on its path is printed, such as
+      forced: 131 in box 2 (or 0,1); 140 to 145 in box 4 (or 2)
+    Give the output to recover.cpp to list which of these moves give valid solutions.
+*/
 
-endloops:
+// the boxes of candidates that some number in [from, to) can still go in
+
+template <uint8_t boxNumAll, class possType, class nType>
+possType Counting<boxNumAll, possType, nType>::openBoxes(const Frame &f, possType candidates, uint32_t from, uint32_t to) {
+  possType open = 0;
+  if (from >= to)
+    return open;
+#ifdef BIT_PLANES
+  for (int box=0; box<boxNumAll; box++) {
+    if (!((candidates >> box) & 1))
+      continue;
+    for (uint32_t i = from >> 6; i <= (to-1) >> 6; i++) {
+      uint64_t word = f.possibilities[box][i];
+      if (i == from >> 6)
+        word &= ~((uint64_t)0) << (from & 63);
+      if (i == (to-1) >> 6)
+        word &= ~((uint64_t)0) >> (63 - ((to-1) & 63));
+      if (word) {
+        open |= (possType)1 << box;
+        break;
+      }
+    }
+  }
+#else
+  for (uint32_t m = from; m < to && (open & candidates) != candidates; m++)
+    open |= f.possibilities[m];
+#endif
+  return open & candidates;
+}
+
+// if n fits a closed box, only try that box and the counting boxes
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::force(Frame &f, int depth) {
+  forcedOthers[depth] = 0;
+  possType options = f.options;
+  if (!(options & (options - 1)))   // at most one box, so there is no branching to remove
+    return;
+
+  possType candidates = 0;
+  possType counting = 0;
+  for (int box=0; box<boxNumAll; box++) {
+    possType bit = (possType)1 << box;
+    if (isCounting[box])
+      counting |= bit;
+    else if ((options & bit) && boxes[box].size())
+      candidates |= bit;
+  }
+  if (!candidates)
+    return;
+
+  // how far the search can get from here
+  uint32_t reach = f.dead;
+  for (int box=0; box<boxNumAll; box++) {
+    if (f.isCountingStill[box] && reach <= maxSteps) {
+      uint32_t end = 2*(reach - 1);   // the interval of a counting box started before reach ends before this
+      reach = end > maxSteps ? maxSteps+1 : firstDead(f, end);
+    }
+  }
+
+  possType closed = candidates & ~openBoxes(f, candidates, (uint32_t)f.n + 1, reach);
+  if (!closed)
+    return;
+
+  possType kept = ((possType)1 << __builtin_ctz(closed)) | (options & counting);
+  forcedN[depth] = f.n;
+  forcedOthers[depth] = options & ~kept & ~counting;
+  f.options = kept;
+  if (depth >= taskDepth) {   // else the task that spawned this one counted it
+    forcedCount++;
+    STAT(stats::forced(depth));
+  }
+}
+
+// print the forced levels above depth, joining runs of numbers with the same boxes
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::printForced(int depth) {
+  std::cout << "forced:";
+  bool any = false;
+  for (int j=0; j<depth; j++) {
+    if (!forcedOthers[j] || isCounting[path[j]])   // n went in a counting box, which was not forced
+      continue;
+    int k = j;
+    while (k+1 < depth && forcedOthers[k+1] == forcedOthers[j] && path[k+1] == path[j]
+           && forcedN[k+1] == forcedN[k] + 1)
+      k++;
+    std::cout << (any ? "; " : " ") << forcedN[j];
+    if (k > j)
+      std::cout << " to " << forcedN[k];
+    std::cout << " in box " << path[j] << " (or ";
+    bool comma = false;
+    for (int box=0; box<boxNumAll; box++) {
+      if ((forcedOthers[j] >> box) & 1) {
+        std::cout << (comma ? "," : "") << box;
+        comma = true;
+      }
+    }
+    std::cout << ")";
+    any = true;
+    j = k;
+  }
+  if (!any)
+    std::cout << " none";
+  std::cout << "\n\n";
+}
+
+
+
+/*
+  One level of the search, which used to be one call of a recursive step().
+  Note that possibilities is only valid from n onwards. For UNDO_TRAIL, every frame
+    shares the same possibilities.
+
+  sums[box] is copy-on-write. A step changes the sums of only one box, so that box's
+    row is copied into ownRow and changed there, and every other sums[i] just points to
+    the same row as the parent's sums[i]. Rows are never changed after they are built,
+    and a parent's rows outlive its children, so sharing them is safe.
+  Before this, every step deep copied all boxNum rows, which is megabytes per step
+    for 16 boxes.
+  For BIT_PLANES, possibilities[box] is a row like sums[box], where bit i is set if i can
+    still go in box, and it is copy-on-write the same way. A step only removes numbers
+    from the one box that it puts n in, so only that row is copied into ownPlane.
+  A counting box that has started has no row. Its sums are intervals (see
+    sumIntervals.h), intervals[box], which are copy-on-write the same way, with
+    ownIntervals holding the intervals of the box that the step changed.
+*/
+template <uint8_t boxNumAll, class possType, class nType>
+struct Counting<boxNumAll, possType, nType>::Frame {
+#ifdef BIT_PLANES
+  uint64_t *possibilities[boxNumAll];
+  uint64_t *ownPlane;          // sumsLength words
+#else
+  possType *possibilities;
+#endif
+  possType options;            // the boxes still to try for n
+  nType dead;                  // the first number from n onwards with possibilities 0, or maxSteps+1
+  nType *trailStart;           // for UNDO_TRAIL, where the current child's trail starts
+  uint64_t *ownRow;            // sumsLength words
+  uint64_t *sums[boxNumAll];   // only valid up to boxNum, and not for counting boxes
+  sumIntervals::List ownIntervals;
+  const sumIntervals::List *intervals[boxNumAll];   // the sums of each counting box that has started
+  nType n;
+  uint8_t boxNum;
+  bool isCountingStill[boxNumAll];
+  bool putInEmptyBox;          // has a previous empty non-counting box had n put inside?
+  bool putInEmptyCountingBox;  // has a previous empty counting box had n put inside?
+  int box;                     // the box that the current child put n in
+  int undo;                    // how many numbers the current child added to boxes[box]
+  uint64_t tableKey;           // the key to store when this frame is done, or 0 (see --table)
+  uint64_t tableFrames;        // frameCount and bestsFound when the frame was entered
+  uint64_t tableBests;
+  bool spawned;                // has a child been handed to a pool task? (see --threads)
+};
 
-        // place n
-        sumsNew[ndiv] |= ((uint64_t) 1 << nmod);
 
+
+/*
+  The memory for the frames. framesPerBlock frames are allocated together the first
+    time the search gets that deep, and they are zeroed right away so that all of
+    their pages are touched once, up front. Frames are then reused for the rest of
+    the search, so going back down to a depth never page faults again.
+  A std::deque is used so that a Frame& stays valid when more frames are added.
+  For UNDO_TRAIL, the arena also holds the one possibilities[] and the trail. A box is
+    only removed from each number once along a branch, so the trail never holds more
+    than maxSteps*boxNumAll numbers.
+*/
+template <uint8_t boxNumAll, class possType, class nType>
+class Counting<boxNumAll, possType, nType>::FrameArena {
+public:
+  FrameArena() {
+#ifdef UNDO_TRAIL
+    possibilitiesBlocks.emplace_back(new possType[maxSteps+1]());
+    trail.reset(new nType[(maxSteps+1) * (size_t)boxNumAll + 1]);
+#endif
+#ifdef BIT_PLANES
+    planeBlocks.emplace_back(new uint64_t[boxNumAll * (size_t)sumsLength]());   // the root's rows
+#endif
+    grow();
+  }
+  Frame &frame(int depth) {
+    while (depth >= (int)frames.size())
+      grow();
+    return frames[depth];
+  }
+  nType *trailBegin() { return trail.get(); }
+  uint64_t *rootPlane(int box) { return planeBlocks[0].get() + box * (size_t)sumsLength; }
+private:
+  static const int framesPerBlock = 16;
+  std::deque<Frame> frames;
+  std::vector<std::unique_ptr<possType[]> > possibilitiesBlocks;
+  std::vector<std::unique_ptr<uint64_t[]> > rowBlocks;
+  std::vector<std::unique_ptr<uint64_t[]> > planeBlocks;
+  std::unique_ptr<nType[]> trail;
+  void grow() {
+#if defined(BIT_PLANES)
+    planeBlocks.emplace_back(new uint64_t[framesPerBlock * (size_t)sumsLength]());
+#elif !defined(UNDO_TRAIL)
+    possibilitiesBlocks.emplace_back(new possType[framesPerBlock * (size_t)(maxSteps+1)]());
+#endif
+    rowBlocks.emplace_back(new uint64_t[framesPerBlock * (size_t)sumsLength]());
+    for (int i=0; i<framesPerBlock; i++) {
+      Frame f = Frame();   // zeroed, so that copying it into frames reads no uninitialized members
+#if defined(BIT_PLANES)
+      f.ownPlane = planeBlocks.back().get() + i * (size_t)sumsLength;
+#elif defined(UNDO_TRAIL)
+      f.possibilities = possibilitiesBlocks[0].get();
+#else
+      f.possibilities = possibilitiesBlocks.back().get() + i * (size_t)(maxSteps+1);
+#endif
+      f.ownRow = rowBlocks.back().get() + i * (size_t)sumsLength;
+      frames.push_back(f);
     }
+  }
+};
+
+
+
+// the boxes that n can go in
+
+template <uint8_t boxNumAll, class possType, class nType>
+inline possType Counting<boxNumAll, possType, nType>::boxesOf(const Frame &f, nType n) {
+#ifdef BIT_PLANES
+  possType options = 0;
+  for (int box=0; box<boxNumAll; box++)
+    options |= (possType)((f.possibilities[box][n >> 6] >> (n & 63)) & 1) << box;
+  return options;
+#else
+  return f.possibilities[n];
+#endif
+}
+
+// the first number from "from" onwards that cannot go in any box, or maxSteps+1
+
+template <uint8_t boxNumAll, class possType, class nType>
+nType Counting<boxNumAll, possType, nType>::firstDead(const Frame &f, nType from) {
+#ifdef BIT_PLANES
+  for (nType i = from >> 6; i < sumsLength; i++) {
+    uint64_t any = 0;
+    for (int box=0; box<boxNumAll; box++)
+      any |= f.possibilities[box][i];
+    uint64_t none = ~any;
+    if (i == from >> 6)
+      none &= ~((uint64_t)0) << (from & 63);
+    if (i == sumsLength-1)
+      none &= ~((uint64_t)0) >> (63 - (maxSteps & 63));
+    if (none)
+      return __builtin_ctzll(none) + (i << 6);
+  }
+  return maxSteps+1;
+#else
+  return simd::firstZero(f.possibilities, from, maxSteps+1);
+#endif
+}
+
+
 
+// everything needed to continue from the node at this depth
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::writeCheckpoint(int depth) {
+  checkpoint::Fields fields;
+  fields["boxNumAll"] = std::to_string(boxNumAll);
+  fields["best"] = std::to_string(best);
+  fields["counts"] = checkpoint::join(counts, boxNumAll);
+  fields["path"] = checkpoint::join(path, depth);
+  fields["prefix"] = checkpoint::join(prefix.data(), (int)prefix.size());
+  fields["counting"] = checkpoint::join(isCounting, boxNumAll);
+  fields["minStart"] = checkpoint::join(minStart, boxNumAll);
+  fields["maxStart"] = checkpoint::join(maxStart, boxNumAll);
+  fields["increaseNeeded"] = std::to_string((int)increaseNeeded);
+  fields["forced"] = std::to_string((int)forcing);
+  if (!checkpoint::save(checkpointFile, fields))
+    std::cout << "  could not write checkpoint " << checkpointFile << '\n' << std::flush;
 }
 
 
-// the recursive function
 
-void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLength], nType n, uint8_t boxNum, bool isCountingStill[boxNumAll]) {
+// The search used to be a recursive step(), but each call put possibilitiesNew[] and
+//   sumsNew[][] on the stack, which needed ulimit -s for large boxNumAll. Now, each
+//   level of the recursion is a Frame, and the frames are kept on an explicit stack.
+// enterFrame() is the start of the old step(), nextChild() is its while loop up to
+//   the recursive call, and childReturned() is what came after the recursive call.
+
+// returns false if there is nothing to search below this frame
+
+template <uint8_t boxNumAll, class possType, class nType>
+bool Counting<boxNumAll, possType, nType>::enterFrame(Frame &f, int depth) {
+
+  nType n = f.n;
+  uint32_t bestNow = best.load(std::memory_order_relaxed);
+
+  if (checkpointDue.load(std::memory_order_relaxed)) {
+    checkpointDue = false;
+    writeCheckpoint(depth);
+  }
+
+  STAT(if (depth >= taskDepth) stats::node(depth));   // a pool task's replayed levels were already counted
 
   // prune sooner rather than later
-  for (int i = n+1; i < best+1; i++)    // change best+2 to best+1 to get ALL best solutions
-    if (!possibilities[i])
-      return;
+  // If dead is n itself, it is not pruned here, since n-1 might be a new best.
+
+  if (f.dead > n && f.dead < bestNow+1) {    // change best+2 to best+1 to get ALL best solutions
+    STAT(stats::prune(depth, f.dead - n));
+    return false;
+  }
 
   if (n > maxSteps) {
     increaseNeeded = true;
-    return;
+    return false;
   }
 
+  STAT(if (f.dead == n) stats::leaf(depth));
+
   // see if we might have a new best!
   int temp = n-1;   // candidate for new best
-  if (temp >= best && !possibilities[n]) {     // change > to >= to get ALL best solutions
-    best = temp;
-    std::cout << temp << '\n';
-    printBoxes();
-    std::cout << "\n\n" << std::flush;
-    return;
+  if (temp >= bestNow && f.dead == n) {     // change > to >= to get ALL best solutions
+    std::lock_guard<std::mutex> lock(printMutex);
+    if (temp >= best) {     // check again now that no other thread can change best
+      best = temp;
+      bestFound = temp;
+      bestsFound++;
+      if (sweepIndex >= 0)
+        std::cout << "configuration " << sweepIndex+1 << ": ";
+      if (solutions.opened()) {
+        writeSolution(temp);
+        std::cout << temp << '\n';
+      } else {
+        std::cout << temp << '\n';
+        printBoxes();
+        std::cout << "\n\n";
+      }
+      if (forcing)
+        printForced(depth);
+      std::cout << std::flush;
+    }
+    return false;
   }
 
 
@@ -268,25 +890,127 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
 */
 
 
-  bool putInEmptyBox = false;          // has a previous empty non-counting box had n put inside?
-  bool putInEmptyCountingBox = false;  // has a previous empty counting box had n put inside?
+  // collect the states for --generate instead of searching deeper
+  if (generateDepth && depth == generateDepth) {
+    std::string state;
+    for (int j=0; j<depth; j++)
+      state += std::to_string(path[j]) + (j<depth-1 ? "," : "");
+    generated.push_back(state);
+    return false;
+  }
+
+  // prune if the search cannot get to best by the bound of bounds.h (see --bound)
+  // Counting boxes that have not started can take any number, so only the other boxes
+  //   have units.
+  if (useBounds && f.dead > n && n <= bestNow) {
+    possType propagate = 0;
+    for (int box=0; box<boxNumAll; box++)
+      if (!f.isCountingStill[box])
+        propagate |= (possType)1 << box;
+    uint32_t last = bestNow < maxSteps ? bestNow : maxSteps;   // best+1 if only > best is wanted
+    auto copySums = [&](int box, uint64_t *row, uint32_t words) {
+      if (isCounting[box])   // only ever needed as a row here
+        sumIntervals::toRow(*f.intervals[box], row, words);
+      else
+        for (uint32_t i=0; i<words; i++)
+          row[i] = f.sums[box][i];
+    };
+    if (bounds::firstUnreachable<possType>([&](uint32_t m) { return boxesOf(f, m); },
+                                           copySums, boxNumAll, propagate, n, last))
+      return false;
+  }
+
+  // skip states whose subtree was already searched (see --table)
+  f.tableKey = 0;
+  frameCount++;
+  if (table.enabled() && !generateDepth && depth >= (int)prefix.size() && depth < tableUntil
+      && depth >= resumeDepth && depth >= taskDepth) {
+    uint64_t key = stateKey(f);
+    uint32_t stored;
+    if (table.find(key, stored) && stored <= bestNow)
+      return false;
+    f.tableKey = key;
+    f.tableFrames = frameCount;
+    f.tableBests = bestsFound;
+  }
+
+  // the boxes to try, which a starting state fixes at each of the first levels
+  f.options = boxesOf(f, n);
+  if (depth < (int)prefix.size())
+    f.options &= (possType)1 << prefix[depth];
+  else if (forcing)
+    force(f, depth);
+  if (depth < taskDepth)   // a pool task first replays the path to its subtree
+    f.options &= (possType)1 << taskPath[depth];
+
+  f.putInEmptyBox = false;
+  f.putInEmptyCountingBox = false;
+  f.spawned = false;
+  return true;
+}
+
+
+
+// Build the next child of f in child, which is the frame one level deeper.
+// Returns false once every box has been tried.
+
+template <uint8_t boxNumAll, class possType, class nType>
+bool Counting<boxNumAll, possType, nType>::nextChild(Frame &f, Frame &child, int depth) {
+
+#ifdef BIT_PLANES
+  uint64_t **possibilities = f.possibilities;
+  uint64_t **possibilitiesNew = child.possibilities;
+  uint64_t *planeNew = child.ownPlane;   // the one row of possibilitiesNew[] that gets changed
+#else
+  possType *possibilities = f.possibilities;
+  possType *possibilitiesNew = child.possibilities;
+#endif
+  uint64_t **sums = f.sums;
+  nType n = f.n;
+  uint8_t boxNum = f.boxNum;
+  bool *isCountingStill = f.isCountingStill;
+
+  uint64_t **sumsNew = child.sums;
+  uint64_t *rowNew = child.ownRow;   // the one row of sumsNew[] that gets changed
+
+  possType &options = f.options;
+  bool &putInEmptyBox = f.putInEmptyBox;                  // has a previous empty non-counting box had n put inside?
+  bool &putInEmptyCountingBox = f.putInEmptyCountingBox;  // has a previous empty counting box had n put inside?
 
   // for updating sums[], assuming that it is uint64_t
-  int nmod = n & 63;   // n%64
+  int nmod = n & 63;   // n%64
   nType ndiv = n >> 6; // n/64
 
+  // for UNDO_TRAIL, the end of the trail while building the child
+  nType *top = trailTop;
+  f.trailStart = top;
+
   // try to place n in each box
-  while(possibilities[n]) {
-      int box = __builtin_ctz( possibilities[n] );   // count trailing zeros
+  while(options) {
+      int box = __builtin_ctz( options );   // count trailing zeros
 
       // bit mask
       possType mask0 = ((possType)1 << box);
 
-      uint32_t n2 = (uint32_t)n << 1;
+      // when resuming, the boxes before the one on the checkpoint's path were already searched
+      if (depth < resumeDepth) {
+        if (box < resumePath[depth]) {
+          if ( !boxes[box].size() ) {   // as if this box was tried, for the pruning of initial identical steps
+            if (isCountingStill[box])
+              putInEmptyCountingBox = true;
+            else if (!isCounting[box])
+              putInEmptyBox = true;
+          }
+          options -= mask0;
+          continue;
+        }
+        if (box > resumePath[depth])   // the checkpoint's branch is finished
+          resumeDepth = 0;
+      }
+
+      path[depth] = box;
 
-      // declare
-      uint64_t sumsNew[boxNumAll][sumsLength];
-      possType possibilitiesNew[maxSteps+1];
+      uint32_t n2 = (uint32_t)n << 1;
 
 /*
       // strangely, this code once sped things up if -O2 or -O3 compiler flag was used !!
@@ -299,12 +1023,12 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
       // old way to enforce certain filling patterns
       //if (n>=5391 && n<=5403 && box!=3) {
       if (n>=5390 && n<=5402 && box!=3) {
-        possibilities[n] -= mask0;
+        options -= mask0;
         continue;
       }
       if (n>=10819 && n<=10892 && box!=5) {
       //if (n>=10808 && n<=10881 && box!=5) {
-        possibilities[n] -= mask0;
+        options -= mask0;
         continue;
       }
 */
@@ -320,7 +1044,8 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
         // to speed things up, prune initial identical steps
         if ( !boxes[box].size() ) {  // is this check necessary??
           if (putInEmptyCountingBox) {
-            possibilities[n] -= mask0;
+            STAT(stats::symmetrySkip(depth, 1));
+            options -= mask0;
             continue;
           }
           putInEmptyCountingBox = true;
@@ -328,7 +1053,7 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
 
         // this should occur after pruning
         if (n > maxStart[box]) {
-          possibilities[n] -= mask0;
+          options -= mask0;
           continue;
         }
 
@@ -339,10 +1064,13 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
         boxes[box].emplace_back(n2 - 1);
 
 
-        counts[box]++;
+        if (depth >= resumeDepth && depth >= taskDepth)   // else it was already counted before the checkpoint or by the task that spawned this one
+          counts[box]++;
 
+#if !defined(UNDO_TRAIL) && !defined(BIT_PLANES)
         // bit mask for removing from possibilitiesNew
         possType mask = ~mask0;
+#endif
 
         uint32_t temp0 = firstAllowed((uint32_t) n);
 
@@ -351,12 +1079,35 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
           uint32_t temp2 = temp0 + n2;
 
           // set this box to no longer be a counting box
-          bool isCountingStillNew[boxNumAll];
-          for (int i=0; i<boxNumAll; i++)
+          bool *isCountingStillNew = child.isCountingStill;
+          for (int i=0; i<boxNumAll; i++) {
             isCountingStillNew[i] = isCountingStill[i];
+            child.intervals[i] = f.intervals[i];
+          }
           isCountingStillNew[box] = false;
 
           // set possibilitiesNew[] starting at 2*n (valid for n>4)
+#if defined(BIT_PLANES)
+          for (int i=0; i<boxNumAll; i++)   // only the row of box changes
+            possibilitiesNew[i] = possibilities[i];
+          possibilitiesNew[box] = planeNew;
+          for (nType i = n2 >> 6; i < sumsLength; i++)
+            planeNew[i] = possibilities[box][i];
+          uint64_t allowed = planeNew[temp0 >> 6] & ((uint64_t)1 << (temp0 & 63));
+          clearRange(planeNew, n2, temp0+n);   // exclude through firstAllowed + n
+          planeNew[temp0 >> 6] |= allowed;     // allow firstAllowed
+          if (temp2 <= maxSteps)
+            planeNew[temp2 >> 6] &= ~((uint64_t)1 << (temp2 & 63));  // exclude firstAllowed + 2*n
+#elif defined(UNDO_TRAIL)
+          for (uint32_t i=n2; i <= temp0+n; i++) {   // exclude through firstAllowed + n, but allow firstAllowed
+            if (i > maxSteps)
+              break;
+            if (i != temp0)
+              removeBox(possibilitiesNew, i, mask0, top);
+          }
+          if (temp2 <= maxSteps)
+            removeBox(possibilitiesNew, temp2, mask0, top);  // exclude firstAllowed + 2*n
+#else
           for (int i=n2; i <= temp0+n; i++) {   // exclude through firstAllowed + n
             if (i > maxSteps)
               break;
@@ -368,43 +1119,64 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
           possibilitiesNew[temp0] = possibilities[temp0];   // allow firstAllowed
           if (temp2 <= maxSteps)
             possibilitiesNew[temp2] = possibilities[temp2] & mask;  // exclude firstAllowed + 2*n
+#endif
 
 
-          // deep copy sums[] up to boxNum
+          // share the rows of sums[] up to boxNum
           for (int i=0; i<boxNum; i++)
-            for (int j=0; j<sumsLength; j++)
-              sumsNew[i][j] = sums[i][j];
-
-          // add box to sums[]; would it be faster to initialize as 1's then remove??? or to not initialize here??
-          for (int j=0; j<sumsLength; j++)
-            sumsNew[boxNum][j] = 0;
-
-          // add sums to sumsNew[boxNum]; valid for n>4
-          for (int i=n; i <= temp0+n; i++) {   // n through firstAllowed + n set as sums
-            if (i > maxSteps)
-              break;
-            sumsNew[boxNum][i >> 6] |= ((uint64_t) 1 << (i & 63));
-          }
-          sumsNew[boxNum][n2 >> 6]    &=  ~((uint64_t) 1 << (n2 & 63));     // remove 2*n as a sum
-          sumsNew[boxNum][temp0 >> 6] &=  ~((uint64_t) 1 << (temp0 & 63));  // remove firstAllowed as sum
-          if (temp2 <= maxSteps)
-            sumsNew[boxNum][temp2 >> 6] |= ((uint64_t) 1 << (temp2 & 63));   // firstAllowed + 2*n is a sum
-
-
-          step(possibilitiesNew, sumsNew, n2, boxNum+1, isCountingStillNew);
+            sumsNew[i] = sums[i];
+          sumsNew[boxNum] = nullptr;   // box has intervals instead
+
+          // the sums of box as intervals (see sumIntervals.h); valid for n>4
+          sumIntervals::List &intervalsNew = child.ownIntervals;
+          intervalsNew.clear();
+          sumIntervals::add(intervalsNew, n, n2 - 1);                        // n through firstAllowed + n are sums,
+          sumIntervals::add(intervalsNew, n2 + 1, temp0 - 1);                // except 2*n
+          sumIntervals::add(intervalsNew, temp0 + 1, temp0 + n, maxSteps);   // and firstAllowed
+          sumIntervals::add(intervalsNew, temp2, temp2, maxSteps);           // firstAllowed + 2*n is a sum
+          child.intervals[box] = &intervalsNew;
+
+
+          child.n = n2;
+          child.dead = firstDead(child, n2);   // many numbers lost a box, so just look
+          child.boxNum = boxNum+1;
+          f.box = box;
+          f.undo = 3;
+          trailTop = top;
+          return true;
 
         } else {
 
           // copy possibilities[] starting at 2*n, but remove box
+#if defined(BIT_PLANES)
+          for (int i=0; i<boxNumAll; i++)
+            possibilitiesNew[i] = possibilities[i];
+          possibilitiesNew[box] = planeNew;
+          for (nType i = n2 >> 6; i < sumsLength; i++)   // nothing from 2*n on can go in box
+            planeNew[i] = 0;
+#elif defined(UNDO_TRAIL)
+          for (uint32_t i=n2; i<maxSteps+1; i++)
+            removeBox(possibilitiesNew, i, mask0, top);
+#else
           for (int i=n2; i<maxSteps+1; i++)
             possibilitiesNew[i] = possibilities[i] & mask;
-
-          step(possibilitiesNew, sums, n2, boxNum, isCountingStill);
+#endif
+
+          for (int i=0; i<boxNum; i++)   // nothing in sums[] changes
+            sumsNew[i] = sums[i];
+          child.n = n2;
+          child.dead = firstDead(child, n2);   // many numbers lost a box, so just look
+          child.boxNum = boxNum;
+          for (int i=0; i<boxNumAll; i++) {
+            child.isCountingStill[i] = isCountingStill[i];
+            child.intervals[i] = f.intervals[i];
+          }
+          f.box = box;
+          f.undo = 3;
+          trailTop = top;
+          return true;
         }
 
-        // put boxes[box] back the way it was
-        boxes[box].resize( boxes[box].size() - 3 );
-
 
       ///////////////////////////////////////
       ///////////////////////////////////////
@@ -438,15 +1210,19 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
         for (int i = n+1; i < n+len; i++) {
           if (i > maxSteps) {
             increaseNeeded = true;
-            return;
+            return false;
           }
+#ifdef BIT_PLANES
+          if (! ((possibilities[box][i >> 6] >> (i & 63)) & 1) ) {
+#else
           if (! (possibilities[i] & mask0) ) {
+#endif
             stop = true;
             break;
           }
         }
         if (stop) {
-            possibilities[n] -= mask0;
+            options -= mask0;
             continue;
         }
 
@@ -457,22 +1233,43 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
         boxes[box].emplace_back(n+len-1);
 
 
-        // deep copy sums[] up to boxNum
+        // share the rows of sums[] up to boxNum, and the intervals of the other counting boxes
         for (int i=0; i<boxNum; i++)
-          for (int j=0; j<sumsLength; j++)
-            sumsNew[i][j] = sums[i][j];
-
+          sumsNew[i] = sums[i];
+        for (int i=0; i<boxNumAll; i++)
+          child.intervals[i] = f.intervals[i];
+        child.intervals[box] = &child.ownIntervals;
+
+#if defined(BIT_PLANES)
+        // share the rows of possibilities[] too, but copy the row of box
+        for (int i=0; i<boxNumAll; i++)
+          possibilitiesNew[i] = possibilities[i];
+        possibilitiesNew[box] = planeNew;
+        for (nType i = n >> 6; i < sumsLength; i++)
+          planeNew[i] = possibilities[box][i];
+
+        // update the intervals of box and possibilitiesNew[box][]
+        subsequentFill(*f.intervals[box], child.ownIntervals, planeNew, n, len);
+#else
+#ifndef UNDO_TRAIL
         // copy possibilities[] starting at n+1
         for (int i=n+1; i<maxSteps+1; i++)
           possibilitiesNew[i] = possibilities[i];
+#endif
 
-        // update sumsNew[box][] and possibilitiesNew[]
-        subsequentFill(sumsNew[box], possibilitiesNew, n, len, ~mask0);
-
-        step(possibilitiesNew, sumsNew, n+len, boxNum, isCountingStill);
+        // update the intervals of box and possibilitiesNew[]
+        subsequentFill(*f.intervals[box], child.ownIntervals, possibilitiesNew, n, len, mask0, top);
+#endif
 
-        // put boxes[box] back the way it was
-        boxes[box].resize( boxes[box].size() - 3 );
+        child.n = n+len;
+        child.dead = firstDead(child, n+len);
+        child.boxNum = boxNum;
+        for (int i=0; i<boxNumAll; i++)
+          child.isCountingStill[i] = isCountingStill[i];
+        f.box = box;
+        f.undo = 3;
+        trailTop = top;
+        return true;
 
 
 
@@ -485,71 +1282,287 @@ void step(possType possibilities[maxSteps+1], uint64_t sums[boxNumAll][sumsLengt
         // to speed things up, prune initial identical steps
         if ( !boxes[box].size() ) {
           if (putInEmptyBox) {
-            possibilities[n] -= mask0;
+            STAT(stats::symmetrySkip(depth, 1));
+            options -= mask0;
             continue;
           }
           putInEmptyBox = true;
         }
 
 
-        // deep copy sums[] up to boxNum
+        // share the rows of sums[] up to boxNum, but copy the row of box
         for (int i=0; i<boxNum; i++)
-          for (int j=0; j<sumsLength; j++)
-            sumsNew[i][j] = sums[i][j];
+          sumsNew[i] = sums[i];
+        sumsNew[box] = rowNew;
+        for (int j=0; j<sumsLength; j++)
+          rowNew[j] = sums[box][j];
 
+#if defined(BIT_PLANES)
+        // share the rows of possibilities[] too, but copy the row of box
+        for (int i=0; i<boxNumAll; i++)
+          possibilitiesNew[i] = possibilities[i];
+        possibilitiesNew[box] = planeNew;
+        for (nType i=ndiv; i<sumsLength; i++)
+          planeNew[i] = possibilities[box][i];
+#elif !defined(UNDO_TRAIL)
         // copy possibilities[] starting at n+1
         for (int i=n+1; i<maxSteps+1; i++)
           possibilitiesNew[i] = possibilities[i];
+#endif
 
-
-        // bit mask for removing from possibilitiesNew
-        possType mask = ~mask0;
+        // dead for the child (f.dead > n since possibilities[n] is not 0)
+        nType deadNew = f.dead;
 
         // remove 2*n from possibilitiesNew
-        if (n2 <= maxSteps)
-          possibilitiesNew[n2] &= mask;  // remove from possibilities
+        if (n2 <= maxSteps) {
+#ifdef BIT_PLANES
+          planeNew[n2 >> 6] &= ~((uint64_t)1 << (n2 & 63));
+#else
+          removeBox(possibilitiesNew, n2, mask0, top);  // remove from possibilities
+#endif
+          if (!boxesOf(child, n2) && n2 < deadNew)
+            deadNew = n2;
+        }
 
-        // remove sums from possibilitiesNew and update sumsNew
+        // update sumsNew
         for (int i=0; i<sumsLength; i++) {         // i represents 64 possible sums
           uint64_t temp = sums[box][i];
 
           // Basically, bit shift sums[] by n to get the new sums.
           // Tricky since sums[] is uint64_t, so sums come in groups of 64
-          if (i + ndiv < sumsLength)
-            sumsNew[box][i + ndiv] |= (temp << nmod);
+          if (i + ndiv < sumsLength)
+            rowNew[i + ndiv] |= (temp << nmod);
           if (i + ndiv + 1 < sumsLength  && nmod)
-          // nmod=0 needs to handled separately to prevent annoyingly-undefined behavior of right bitshift, hence the &&nmod
-            sumsNew[box][i + ndiv + 1] |= (temp >> (64 - nmod));
+          // nmod=0 needs to handled separately to prevent annoyingly-undefined behavior of right bitshift, hence the &&nmod
+            rowNew[i + ndiv + 1] |= (temp >> (64 - nmod));
+        }
 
+        // remove the NEWsums (rowNew & ~sums[box]) from possibilitiesNew, like boxes.cpp
+        // The old sums were already removed when they became sums.
+#if defined(BIT_PLANES)
+        // whole words at a time, then a number that was just removed is dead if no other box has it
+        for (nType i=ndiv; i<sumsLength; i++) {
+          uint64_t removed = planeNew[i] & rowNew[i] & ~sums[box][i];
+          planeNew[i] &= ~(rowNew[i] & ~sums[box][i]);
+          if (removed && (nType)(i << 6) < deadNew) {
+            uint64_t any = 0;
+            for (int b=0; b<boxNumAll; b++)
+              any |= possibilitiesNew[b][i];
+            removed &= ~any;
+            if (removed && (nType)(__builtin_ctzll(removed) + (i << 6)) < deadNew)
+              deadNew = __builtin_ctzll(removed) + (i << 6);
+          }
+        }
+#elif defined(UNDO_TRAIL)
+        for (int i=ndiv; i<sumsLength; i++) {
+          uint64_t temp = rowNew[i] & ~sums[box][i];
           while(temp) {
             int k = __builtin_ctzll( temp );       // count trailing zeros
-            uint32_t j = k + (i << 6) + (uint32_t)n;   // k + (i<<6) is the sum being added to
+            uint32_t j = k + (i << 6);
             if (j > maxSteps)
               goto endloops;
-            possibilitiesNew[j] &= mask;         // remove from possibilitiesNew[]
-            //sumsNew[box][j >> 6] |= ((uint64_t)1 << (j & 63));  // add to sumsNew[]
-            temp -= ((uint64_t)1 << k);
+            removeBox(possibilitiesNew, j, mask0, top);   // remove from possibilitiesNew[]
+            temp &= temp - 1;
           }
         }
-
 endloops:
+        for (nType *t = f.trailStart; t < top; t++)   // the numbers that just lost a box
+          if (!possibilitiesNew[*t] && *t < deadNew)
+            deadNew = *t;
+#else
+        // many at a time using AVX2 or AVX-512 if the CPU has it (see simdKernels.h)
+        uint64_t NEWsums[sumsLength];
+        for (int i=ndiv; i<sumsLength; i++)
+          NEWsums[i] = rowNew[i] & ~sums[box][i];
+        nType zero = simd::clearBits(possibilitiesNew, NEWsums, (int)ndiv, (int)sumsLength, (int)maxSteps+1, mask0);
+        if (zero < deadNew)
+          deadNew = zero;
+#endif
 
         // place n
         boxes[box].emplace_back(n);
-        sumsNew[box][ndiv] |= ((uint64_t) 1 << nmod);
+        rowNew[ndiv] |= ((uint64_t) 1 << nmod);
+
+        child.n = n+1;
+        child.dead = deadNew;
+        child.boxNum = boxNum;
+        for (int i=0; i<boxNumAll; i++) {
+          child.isCountingStill[i] = isCountingStill[i];
+          child.intervals[i] = f.intervals[i];
+        }
+        f.box = box;
+        f.undo = 1;
+        trailTop = top;
+        return true;
+
+      }
+
+  }
+
+  return false;
+}
+
+
+
+// the end of the old while loop, after the recursive call returned
 
-        step(possibilitiesNew, sumsNew, n+1, boxNum, isCountingStill);
+template <uint8_t boxNumAll, class possType, class nType>
+inline void Counting<boxNumAll, possType, nType>::childReturned(Frame &f) {
 
-        // remove n
-        boxes[box].pop_back();
+  // put boxes[box] back the way it was
+  if (f.undo == 1)
+    boxes[f.box].pop_back();
+  else
+    boxes[f.box].resize( boxes[f.box].size() - f.undo );
 
+#ifdef UNDO_TRAIL
+  // put possibilities[] back the way it was
+  possType bit = (possType)1 << f.box;
+  while (trailTop > f.trailStart)
+    f.possibilities[*--trailTop] |= bit;
+#endif
+
+  f.options -= ((possType)1 << f.box);  // so that the while loop progresses
+
+}
+
+
+
+// The key of the state of frame f for the transposition table (see transposition.h).
+// Unlike boxes.cpp, the key has all of possibilities[] from n on, and the sums that
+//   could still matter below maxSteps, instead of only the numbers below best+2. A
+//   counting box places a whole interval without looking at possibilities[], so a path
+//   can get past best+2 and still stop without a new best when a later interval does
+//   not fit, and where it stops depends on every possibility after best. So this key
+//   does not depend on best, and an entry stays good as best grows. For 14 boxes,
+//   that is 49152 numbers for each key, which is why only shallow frames have one.
+// Counting boxes cannot be renamed (minStart[], maxStart[], and the order they start
+//   in belong to each box), so their number is part of their hash.
+
+template <uint8_t boxNumAll, class possType, class nType>
+uint64_t Counting<boxNumAll, possType, nType>::stateKey(const Frame &f) {
+  uint32_t n = f.n;
+  uint32_t end = (uint32_t)maxSteps + 1;
+  uint64_t h[boxNumAll];
+#ifdef BIT_PLANES
+  for (int box=0; box<boxNumAll; box++)
+    h[box] = transposition::hashBits(f.possibilities[box], n, end, 0);
+#else
+  transposition::hashPlanes(f.possibilities, n, end, boxNumAll, h);
+#endif
+  for (int box=0; box<boxNumAll; box++) {
+    if (isCounting[box] && !f.isCountingStill[box]) {   // the intervals of sums below end - n
+      const sumIntervals::List &sums = *f.intervals[box];
+      for (size_t i=0; i<sums.size() && sums[i].first < end - n; i++) {
+        uint64_t last = sums[i].last < end - n ? sums[i].last : end - n - 1;
+        h[box] = transposition::mix(h[box] ^ ((uint64_t)sums[i].first << 32) ^ last);
       }
+    } else if (box < f.boxNum) {
+      h[box] = transposition::hashBits(f.sums[box], 0, end - n, h[box]);
+    }
+    if (isCounting[box]) {
+      uint64_t len = boxes[box].size() ? boxes[box][0] : 0;   // what subsequentFill() adds
+      h[box] = transposition::mix(h[box] ^ ((uint64_t)(box + 1) << 48) ^ ((uint64_t)f.isCountingStill[box] << 40) ^ len);
+    }
+  }
+  return transposition::combine(h, boxNumAll, n);
+}
+
+// Store a finished frame in the table if nothing below it was printed. Then no
+//   solution below it reached best, and the same holds for any equal state later,
+//   when best can only be the same or more. A frame that spawned pool tasks is not
+//   done until they are, so it is not stored.
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::frameDone(const Frame &f) {
+  if (f.tableKey && !f.spawned && bestsFound == f.tableBests && !increaseNeeded)
+    table.store(f.tableKey, best, frameCount - f.tableFrames);
+}
 
 
 
-      possibilities[n] -= mask0;  // so that the while loop progresses
+// For --threads, whether the child that nextChild() just built from f becomes a pool
+//   task instead of being searched here. Like boxes.cpp, every branch above splitDepth
+//   does. Below that, a counting box starting at n is a subtree of its own, and where
+//   each counting box starts is what takes the time for 10+ boxes, so these are
+//   handed out too whenever the pool is running out of tasks.
 
+template <uint8_t boxNumAll, class possType, class nType>
+inline bool Counting<boxNumAll, possType, nType>::splits(const Frame &f, int depth) {
+  if (!pool || depth < taskDepth || depth < (int)prefix.size())
+    return false;
+  if (depth < splitDepth)
+    return true;
+  return f.isCountingStill[f.box] && pool->pendingTasks() < 2 * pool->size();
+}
+
+// Hand the child built at depth to the pool. Only its path is kept, since the frames
+//   it would share rows with are reused as soon as this thread goes on, and the task
+//   gets to it again by replaying the path (see runTask()).
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::spawn(int depth) {
+  std::vector<int> taskPathOfTask(path, path + depth + 1);
+  Layout layout;
+  pool->submit([taskPathOfTask, layout]() {
+    layout.use();
+    runTask(taskPathOfTask);
+  });
+}
+
+// Search the subtree at the end of taskPathOfTask, on whichever thread of the pool runs
+//   the task. Each thread has its own frames and boxes[], kept for its next task.
+//   Replaying the levels of the path redoes a little work that the task that spawned
+//   this one already did, but nothing is counted twice.
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::runTask(const std::vector<int> &taskPathOfTask) {
+  static thread_local std::unique_ptr<FrameArena> arena;
+  if (!arena)
+    arena.reset(new FrameArena);
+  initRoot(*arena);
+  taskPath = taskPathOfTask.data();
+  taskDepth = (int)taskPathOfTask.size();
+  run(*arena, 0);
+  taskPath = nullptr;
+  taskDepth = 0;
+  addTaskTotals();
+}
+
+
+
+// run the search below frame number base until it is finished
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::run(FrameArena &arena, int base) {
+
+  if (!enterFrame(arena.frame(base), base))
+    return;
+
+  int depth = base;
+  while (depth >= base) {
+    Frame &f = arena.frame(depth);
+    if (nextChild(f, arena.frame(depth+1), depth)) {
+      STAT(if (depth >= taskDepth) stats::child(depth));
+      if (splits(f, depth)) {   // a pool task searches it instead
+        spawn(depth);
+        f.spawned = true;
+        childReturned(f);
+        continue;
+      }
+      depth++;
+      if (!enterFrame(arena.frame(depth), depth)) {
+        depth--;
+        childReturned(arena.frame(depth));
+      }
+    } else {
+      frameDone(f);
+      depth--;
+      if (depth >= base)
+        childReturned(arena.frame(depth));
+    }
   }
+
 }
 
 
@@ -557,13 +1570,14 @@ endloops:
 
 
 
-int main() {
 
 
 
-  best = 0;    // current best max steps found; increasing this here can speed up the code!
-  increaseNeeded = false;
 
+// set up the frame at depth 0, where nothing has been placed
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::initRoot(FrameArena &arena) {
 
   // set boxNum0
   uint8_t boxNum0 = boxNumAll;
@@ -572,9 +1586,34 @@ int main() {
       boxNum0--;
 
 
-  /* initialize data structures */
+  // Each thread of --sweep has its own of these. They are reached through plain pointers,
+  //   since every use of a thread_local that has a constructor goes through a call.
+  static thread_local std::vector<nType> boxesOfThread[boxNumAll];
+  static thread_local std::vector<int> pathOfThread;
+  static thread_local std::vector<uint32_t> forcedNOfThread, forcedOthersOfThread;
+  boxes = boxesOfThread;
+  pathOfThread.assign(maxSteps+1, 0);
+  path = pathOfThread.data();
+  forcedNOfThread.assign(maxSteps+1, 0);
+  forcedN = forcedNOfThread.data();
+  forcedOthersOfThread.assign(maxSteps+1, 0);
+  forcedOthers = forcedOthersOfThread.data();
+  for (int i=0; i<boxNumAll; i++)
+    boxes[i].clear();
 
-  possType possibilities[maxSteps+1];   // possibilities[0] is never used
+  trailTop = arena.trailBegin();
+  Frame &root = arena.frame(0);
+  root.n = 1;
+  root.boxNum = boxNum0;
+  for (int i=0; i<boxNumAll; i++)
+    root.isCountingStill[i] = isCounting[i];
+
+#ifdef BIT_PLANES
+  std::vector<possType> rootPossibilities(maxSteps+1);   // turned into a row for each box below
+  possType *possibilities = rootPossibilities.data();
+#else
+  possType *possibilities = root.possibilities;   // possibilities[0] is never used
+#endif
   for (int i=1; i<=maxSteps; i++) {
     if (i < 5)             // firstAllowed formula is not true for n<5
       possibilities[i] = ((possType)1 << boxNum0) - (possType)1;   // each bit is a box
@@ -587,7 +1626,7 @@ int main() {
       for (int i=box; i<boxNumAll; i++) {   // loop over all current and later counting boxes
         if (isCounting[i]) {
           possType mask = ~((possType)1 << i);
-          for (int j=5; j<minStart[box]; j++)
+          for (int j=5; j<minStart[box] && j<=maxSteps; j++)
             possibilities[j] = possibilities[j] & mask;
         }
       }
@@ -595,10 +1634,103 @@ int main() {
     }
   }
 
-  uint64_t sums[boxNumAll][sumsLength];
+  for (int j=0; j<sumsLength; j++)   // all of the regular boxes start with the same empty row
+    root.ownRow[j] = 0;
   for (int i=0; i<boxNum0; i++)
-    for (int j=0; j<sumsLength; j++)
-      sums[i][j] = 0;
+    root.sums[i] = root.ownRow;
+  for (int i=0; i<boxNumAll; i++)   // no counting box has started
+    root.intervals[i] = nullptr;
+#ifdef BIT_PLANES
+  for (int box=0; box<boxNumAll; box++) {
+    root.possibilities[box] = arena.rootPlane(box);
+    for (nType j=0; j<sumsLength; j++)   // the arena may be reused (see runTask())
+      root.possibilities[box][j] = 0;
+    for (nType i=1; i<=maxSteps; i++)
+      if (possibilities[i] & ((possType)1 << box))
+        root.possibilities[box][i >> 6] |= (uint64_t)1 << (i & 63);
+  }
+#endif
+  root.dead = firstDead(root, 1);   // from now on, dead is kept up to date instead
+
+}
+
+
+
+// run the search, starting from prefix[]
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::search() {
+
+  if (benchProbes) {
+    bench(benchProbes);
+    return;
+  }
+
+
+  if (sweepIndex < 0)   // --sweep starts best once, since its configurations share it
+    best = startBest;    // current best max steps found; increasing this with --best can speed up the code!
+  bestFound = 0;
+  increaseNeeded = false;
+  for (int i=0; i<boxNumAll; i++)
+    counts[i] = 0;
+
+  if (estimateProbes) {
+    estimate(estimateProbes);
+    return;
+  }
+  if (balanceTasks) {
+    balance(balanceTasks);
+    return;
+  }
+
+  // continue from a checkpoint
+  resumeDepth = 0;
+  if (!resumeFile.empty()) {
+    checkpoint::Fields fields;
+    if (!checkpoint::load(resumeFile, fields) || atoi(fields["boxNumAll"].c_str()) != boxNumAll) {
+      std::cout << "  cannot resume from " << resumeFile << '\n' << std::flush;
+      return;
+    }
+    if (fields["counting"] != checkpoint::join(isCounting, boxNumAll) || fields["minStart"] != checkpoint::join(minStart, boxNumAll)
+        || fields["maxStart"] != checkpoint::join(maxStart, boxNumAll)) {   // the path would be of a different tree
+      std::cout << "  resume " << resumeFile << " with the --counting, --minStart, and --maxStart it was written with:\n    "
+                << fields["counting"] << "  " << fields["minStart"] << "  " << fields["maxStart"] << '\n' << std::flush;
+      return;
+    }
+    std::vector<long long> values = checkpoint::split(fields["path"]);
+    resumePath.assign(values.begin(), values.end());
+    resumeDepth = (int)resumePath.size();
+    values = checkpoint::split(fields["prefix"]);
+    prefix.assign(values.begin(), values.end());
+    values = checkpoint::split(fields["counts"]);
+    for (int i=0; i<boxNumAll && i<(int)values.size(); i++)
+      counts[i] = values[i];
+    best = atoi(fields["best"].c_str());
+    increaseNeeded = atoi(fields["increaseNeeded"].c_str()) != 0;
+    if (atoi(fields["forced"].c_str()) != (int)forcing) {   // the paths would be of different trees
+      std::cout << "  resume " << resumeFile << (forcing ? " without" : " with") << " --forced\n" << std::flush;
+      return;
+    }
+    std::cout << "  resuming at depth " << resumeDepth << " with best " << best << '\n' << std::flush;
+  }
+
+
+  // twice the boxes that are not counting boxes, like 2*boxNum in boxes.cpp
+  tableUntil = (int)prefix.size() + tableDepth;
+  if (!tableDepth)
+    for (int i=0; i<boxNumAll; i++)
+      if (!isCounting[i])
+        tableUntil += 2;
+
+
+  /* initialize data structures */
+
+  bool parallel = numThreads > 1 && sweepIndex < 0 && !generateDepth;   // the threads of --sweep each search alone
+  std::unique_ptr<FrameArena> arena;
+  if (!parallel) {
+    arena.reset(new FrameArena);
+    initRoot(*arena);
+  }
 
 
 
@@ -606,7 +1738,51 @@ int main() {
   std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
 
   // do it
-  step(possibilities, sums, 1, boxNum0, isCounting);
+  std::unique_ptr<checkpoint::Timer> timer;
+  if (!checkpointFile.empty())
+    timer.reset(new checkpoint::Timer(checkpointSeconds, checkpointDue));
+  if (parallel) {
+    if (!splitDepth) {   // twice the boxes that are not counting boxes, like 2*boxNum in boxes.cpp
+      for (int i=0; i<boxNumAll; i++)
+        if (!isCounting[i])
+          splitDepth += 2;
+    }
+    for (int i=0; i<maxBoxNumAll; i++)
+      taskCounts[i] = 0;
+    taskForcedCount = 0;
+    taskIncreaseNeeded = false;
+    pool = new WorkStealingPool(numThreads);
+    Layout layout;
+    pool->submit([layout]() {   // the root, whose shallow levels only create tasks
+      layout.use();
+      runTask(std::vector<int>());
+    });
+    pool->wait();
+    delete pool;   // the threads end here, so their counters are added up for STATS and --bound
+    pool = nullptr;
+    for (int i=0; i<boxNumAll; i++)
+      counts[i] = taskCounts[i];
+    forcedCount = taskForcedCount;
+    increaseNeeded = taskIncreaseNeeded;
+  } else {
+    run(*arena, 0);
+  }
+  timer.reset();
+  checkpointDue = false;
+  {
+    std::lock_guard<std::mutex> lock(printMutex);
+    solutions.flush();
+  }
+  if (sweepIndex >= 0)   // sweep() prints the results of every configuration at the end
+    return;
+
+#ifdef STATS
+  stats::collect();
+  std::string about = "\"program\": \"boxesCounting\", \"boxNum\": " + std::to_string(boxNumAll);
+  if (stats::dump(statsFile, about))
+    std::cout << "  wrote search statistics to " << statsFile << '\n' << std::flush;
+  stats::reset();
+#endif
 
   // stop timer
   long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
@@ -618,8 +1794,773 @@ int main() {
   for (int i=0; i<boxNumAll; i++)
     std::cout << " " << counts[i];
   std::cout << "\n  time for " << static_cast<unsigned>(boxNumAll) << " boxes is " << duration_ms << " ms\n" << std::flush;
+  if (forcing)   std::cout << "  forced levels: " << forcedCount << '\n' << std::flush;
+  table.report();
+  if (useBounds)
+    bounds::report();
   if (increaseNeeded)   std::cout << "  increase maxSteps!!\n" << std::flush;
 
+}
+
+
+
+// Time the pieces of the search separately, for --bench. The states are the frames
+//   reached by random probes, each of which starts at the root and builds the child
+//   for a random box of options until there is none. At each frame, each piece that
+//   applies is timed reps times, and the bytes are the parts of the arrays that each
+//   piece goes through (see bench.h).
+// Starting a counting box and a regular step are timed as nextChild() restricted to one
+//   box, followed by childReturned(), so they include copying possibilities[] and, for a
+//   regular step, a row of sums[]. The two are told apart by the kind of box, and counting box starts
+//   include the look-ahead for the child's dead.
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::bench(int probes) {
+
+  const int reps = 16;
+  bench::Kernel lookKernel("look-ahead prune");
+  bench::Kernel regularKernel("regular step");
+  bench::Kernel startKernel("counting box start");
+  bench::Kernel fillKernel("subsequentFill");
+
+  std::mt19937 random(1);   // the same probes every time
+  uint64_t states = 0;
+  uint64_t countsBefore[maxBoxNumAll];
+  for (int i=0; i<boxNumAll; i++)
+    countsBefore[i] = counts[i];
+  best = 0;
+  increaseNeeded = false;
+  resumeDepth = 0;
+
+  FrameArena arena;
+  initRoot(arena);
+
+#ifdef BIT_PLANES
+  std::vector<uint64_t> possibilitiesCopy(sumsLength);   // the row of the box for subsequentFill()
+#else
+  std::vector<possType> possibilitiesCopy(maxSteps+1);
+#endif
+  sumIntervals::List intervalsCopy;
+  std::vector<nType> trailCopy(maxSteps+1);   // for UNDO_TRAIL, each number is removed from the box at most once
+
+  for (int probe=0; probe<probes; probe++) {
+
+    Frame &root = arena.frame(0);
+    root.options = boxesOf(root, root.n);
+    int depth = 0;
+    while (true) {
+      Frame &f = arena.frame(depth);
+      Frame &child = arena.frame(depth+1);
+      nType n = f.n;
+      possType options = f.options;
+
+      // like nextChild(), only the first empty box of each kind, since the others would only rename boxes
+      bool emptyRegular = false, emptyCounting = false;
+      for (int box=0; box<boxNumAll; box++) {
+        possType bit = (possType)1 << box;
+        if (!(options & bit) || boxes[box].size())
+          continue;
+        if (f.isCountingStill[box]) {
+          if (emptyCounting)
+            options &= ~bit;
+          emptyCounting = true;
+        } else if (!isCounting[box]) {
+          if (emptyRegular)
+            options &= ~bit;
+          emptyRegular = true;
+        }
+      }
+      if (n > maxSteps || !options)
+        break;
+      states++;
+      nType ndiv = n >> 6;
+
+      // the scan that the prune did at every step before dead was kept up to date
+      nType dead = firstDead(f, n);
+#ifdef BIT_PLANES
+      double lookBytes = 8.0 * boxNumAll * (((dead > maxSteps ? maxSteps : dead) >> 6) - ndiv + 1);
+#else
+      double lookBytes = sizeof(possType) * ((dead > maxSteps ? maxSteps : dead) - n + 1);
+#endif
+      lookKernel.time(reps, lookBytes, [&]() {
+        nType dead = firstDead(f, n);
+        bench::keep(dead);
+      });
+
+      // one box of each kind
+      int regularBox = -1, startBox = -1, fillBox = -1;
+      for (int box=0; box<boxNumAll; box++) {
+        if (!(options & ((possType)1 << box)))
+          continue;
+        if (f.isCountingStill[box]) {
+          if (startBox < 0 && !boxes[box].size())
+            startBox = box;
+        } else if (isCounting[box]) {
+          if (fillBox < 0)
+            fillBox = box;
+        } else if (regularBox < 0) {
+          regularBox = box;
+        }
+      }
+
+      // nextChild() for just one box, then put everything back
+      auto oneChild = [&](int box) {
+        f.options = (possType)1 << box;
+        f.putInEmptyBox = false;
+        f.putInEmptyCountingBox = false;
+        if (nextChild(f, child, depth))
+          childReturned(f);
+      };
+
+      if (regularBox >= 0) {
+#if defined(BIT_PLANES)
+        double possibilitiesBytes = 8.0 * 3 * (sumsLength - ndiv);
+#elif defined(UNDO_TRAIL)
+        double possibilitiesBytes = 8.0 * (sumsLength - ndiv);   // plus the few numbers that lose the box
+#else
+        double possibilitiesBytes = sizeof(possType) * 3.0 * (maxSteps - n) + 8.0 * (sumsLength - ndiv);
+#endif
+        regularKernel.time(reps, possibilitiesBytes + 8.0 * 4 * sumsLength, [&]() { oneChild(regularBox); });
+      }
+
+      if (startBox >= 0) {
+        oneChild(startBox);   // once more to find out how far the child's look-ahead went
+        nType from = n << 1;
+        nType to = child.dead > maxSteps ? maxSteps : child.dead;
+#ifdef BIT_PLANES
+        double startBytes = 8.0 * 2 * (sumsLength - (from >> 6)) + 8.0 * boxNumAll * ((to >> 6) - (from >> 6) + 1);
+#else
+        double startBytes = sizeof(possType) * (2.0 * (maxSteps + 1 - from) + (to - from + 1));
+#endif
+        startKernel.time(reps, startBytes, [&]() { oneChild(startBox); });
+      }
+
+      if (fillBox >= 0 && n + boxes[fillBox][0] - 1 <= maxSteps) {
+        nType len = boxes[fillBox][0];
+        possType bit = (possType)1 << fillBox;
+#ifdef BIT_PLANES
+        for (nType i=ndiv; i<sumsLength; i++)
+          possibilitiesCopy[i] = f.possibilities[fillBox][i];
+        double possibilitiesBytes = 8.0 * 3 * (sumsLength - ndiv);
+#else
+        for (nType i=n; i<=maxSteps; i++)
+          possibilitiesCopy[i] = f.possibilities[i];
+        double possibilitiesBytes = sizeof(possType) * 2.0 * (maxSteps + 1 - 64*ndiv) + 8.0 * (sumsLength - ndiv);
+#endif
+        double intervalBytes = sizeof(sumIntervals::Interval) * 3.0 * len * f.intervals[fillBox]->size();
+        fillKernel.time(reps, intervalBytes + possibilitiesBytes, [&]() {
+          nType *top = trailCopy.data();
+#ifdef BIT_PLANES
+          (void)bit;
+          (void)top;
+          subsequentFill(*f.intervals[fillBox], intervalsCopy, possibilitiesCopy.data(), n, len);
+#else
+          subsequentFill(*f.intervals[fillBox], intervalsCopy, possibilitiesCopy.data(), n, len, bit, top);
+#endif
+          bench::keep(intervalsCopy.size());
+        });
+      }
+
+      // go on to the child for a random box of options
+      for (int pick = random() % __builtin_popcount(options); pick > 0; pick--)
+        options &= options - 1;
+      f.options = options & -options;
+      f.putInEmptyBox = false;
+      f.putInEmptyCountingBox = false;
+      if (!nextChild(f, child, depth))
+        break;
+      child.options = boxesOf(child, child.n);
+      child.putInEmptyBox = false;
+      child.putInEmptyCountingBox = false;
+      depth++;
+    }
+
+    // put boxes[] (and the trail) back the way they were at the root
+    for (int d = depth-1; d >= 0; d--)
+      childReturned(arena.frame(d));
+  }
+
+  for (int i=0; i<boxNumAll; i++)
+    counts[i] = countsBefore[i];
+
+  std::cout << "  benchmark for " << static_cast<unsigned>(boxNumAll) << " boxes: " << probes << " probes reached "
+            << states << " states, " << reps << " calls of each kernel per state\n";
+#ifdef BIT_PLANES
+  std::cout << "  layout BIT_PLANES\n";
+#else
+  std::cout << "  layout possibilities[n], simd " << simd::levelName(simd::Kernels<possType>::level) << '\n';
+#endif
+  bench::report({&lookKernel, &regularKernel, &startKernel, &fillKernel});
+
+}
+
+
+
+// run Counting<boxNumAll, possType, nType>::search() for the boxNumAll given at run time
+
+void search(int boxNumAll) {
+  switch (boxNumAll) {
+    case 1:  Counting< 1, uint8_t,  uint16_t>::search(); break;
+    case 2:  Counting< 2, uint8_t,  uint16_t>::search(); break;
+    case 3:  Counting< 3, uint8_t,  uint16_t>::search(); break;
+    case 4:  Counting< 4, uint8_t,  uint16_t>::search(); break;
+    case 5:  Counting< 5, uint8_t,  uint16_t>::search(); break;
+    case 6:  Counting< 6, uint8_t,  uint16_t>::search(); break;
+    case 7:  Counting< 7, uint8_t,  uint16_t>::search(); break;
+    case 8:  Counting< 8, uint8_t,  uint16_t>::search(); break;
+    case 9:  Counting< 9, uint16_t, uint16_t>::search(); break;
+    case 10: Counting<10, uint16_t, uint16_t>::search(); break;
+    case 11: Counting<11, uint16_t, uint16_t>::search(); break;
+    case 12: Counting<12, uint16_t, uint16_t>::search(); break;
+    case 13: Counting<13, uint16_t, uint16_t>::search(); break;
+    case 14: Counting<14, uint16_t, uint16_t>::search(); break;
+    case 15: Counting<15, uint16_t, uint32_t>::search(); break;
+    case 16: Counting<16, uint16_t, uint32_t>::search(); break;
+  }
+}
+
+
+
+// comma-separated box numbers such as 0,1,0,2,0,1
+
+std::vector<int> parseState(const char *text) {
+  std::vector<int> state;
+  for (const char *c = text; *c; ) {
+    if ('0' <= *c && *c <= '9') {
+      char *end;
+      state.push_back((int)strtol(c, &end, 10));
+      c = end;
+    } else {
+      c++;
+    }
+  }
+  return state;
+}
+
+
+
+// a comma-separated setting such as 0,0,0,1,1 for --counting, --minStart, or --maxStart
+
+inline bool isSetting(const std::string &text) {
+  if (text.empty() || text[0] == ',' || text[text.size()-1] == ',')
+    return false;
+  for (size_t i=0; i<text.size(); i++)
+    if (!isdigit((unsigned char)text[i]) && !(text[i] == ',' && text[i-1] != ','))
+      return false;
+  return true;
+}
+
+template <class T>
+void parseSetting(const char *text, T setting[maxBoxNumAll]) {
+  std::vector<long long> values = checkpoint::split(text);
+  for (int i=0; i<maxBoxNumAll && i<(int)values.size(); i++)
+    setting[i] = (T)values[i];
+}
+
+
+
+// Search every configuration of a file, for --sweep. Each line is --counting, --minStart,
+//   and, optionally, --maxStart, separated by spaces, such as
+//     0,0,0,0,1,1  0,0,0,0,27,0
+//     0,0,0,1,1,1  0,0,0,8,0,0
+//   and lines that are empty or start with # are skipped. Whatever a line leaves out
+//   is what was given on the command line (or set above).
+// The configurations are started in order, numThreads at a time (--threads, default one
+//   per core), and they share best, so each one only looks for solutions at least as
+//   good as the best found so far by any of them, and prunes with it. So put the
+//   layouts expected to do well first. Each new best is printed with the number of
+//   its configuration, and a table of the best printed by each configuration ("-" if
+//   none reached the shared best), its counts[], and its time is printed at the end.
+// Returns false, after saying why, if the file cannot be read, has a line that is not
+//   like the ones above, or has no configurations.
+
+struct SweepConfig {
+  std::string text;
+  bool isCounting[maxBoxNumAll];
+  uint32_t minStart[maxBoxNumAll];
+  uint32_t maxStart[maxBoxNumAll];
+  uint32_t best;
+  uint64_t counts[maxBoxNumAll];
+  long long ms;
+  bool increaseNeeded;
+};
+
+bool sweep(int boxNumAll, const std::string &file) {
+
+  std::ifstream in(file);
+  std::vector<SweepConfig> configs;
+  std::string line;
+  for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+    std::istringstream words(line);
+    std::string counting, minimum, maximum, extra;
+    if (!(words >> counting) || counting[0] == '#')
+      continue;
+    words >> minimum >> maximum >> extra;
+    if (!isSetting(counting) || (!minimum.empty() && !isSetting(minimum))
+        || (!maximum.empty() && !isSetting(maximum)) || !extra.empty()) {
+      std::cout << "line " << lineNumber << " of " << file << " is not up to three lists such as"
+                << " 0,0,0,0,1,1  0,0,0,0,27,0:\n  " << line << '\n' << std::flush;
+      return false;
+    }
+    SweepConfig c;
+    for (int i=0; i<maxBoxNumAll; i++) {   // start from the settings of the command line
+      c.isCounting[i] = isCounting[i];
+      c.minStart[i] = minStart[i];
+      c.maxStart[i] = maxStart[i];
+    }
+    c.text = counting;
+    parseSetting(counting.c_str(), c.isCounting);
+    if (!minimum.empty()) {
+      c.text += "  " + minimum;
+      parseSetting(minimum.c_str(), c.minStart);
+    }
+    if (!maximum.empty()) {
+      c.text += "  " + maximum;
+      parseSetting(maximum.c_str(), c.maxStart);
+    }
+    configs.push_back(c);
+  }
+  if (configs.empty()) {
+    std::cout << "cannot read any configuration from " << file << '\n' << std::flush;
+    return false;
+  }
+
+  int threads = numThreads ? numThreads : (int)std::thread::hardware_concurrency();
+  if (threads < 1)
+    threads = 1;
+  if (threads > (int)configs.size())
+    threads = (int)configs.size();
+
+  best = startBest;
+  std::atomic<size_t> next(0);
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  {
+    WorkStealingPool pool(threads);
+    for (int t=0; t<threads; t++) {
+      pool.submit([&]() {   // each thread takes the next configuration until there are none
+        for (size_t i = next++; i < configs.size(); i = next++) {
+          SweepConfig &c = configs[i];
+          for (int j=0; j<maxBoxNumAll; j++) {
+            isCounting[j] = c.isCounting[j];
+            minStart[j] = c.minStart[j];
+            maxStart[j] = c.maxStart[j];
+          }
+          sweepIndex = (int)i;
+          std::chrono::high_resolution_clock::time_point started = std::chrono::high_resolution_clock::now();
+          search(boxNumAll);
+          c.ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - started).count();
+          c.best = bestFound;
+          for (int j=0; j<maxBoxNumAll; j++)
+            c.counts[j] = counts[j];
+          c.increaseNeeded = increaseNeeded;
+        }
+        sweepIndex = -1;
+      });
+    }
+    pool.wait();
+  }   // the threads end here, so their counters are added up for STATS and --bound
+  long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+  // the table
+  size_t width = 13;
+  for (size_t i=0; i<configs.size(); i++)
+    width = std::max(width, configs[i].text.size());
+  std::cout << "  sweep of " << configs.size() << " configurations for " << boxNumAll << " boxes on " << threads
+            << " threads: best is " << best << ", time is " << duration_ms << " ms\n";
+  std::cout << "     #      best   time (ms)  " << std::left << std::setw(width) << "configuration" << std::right << "  counts\n";
+  for (size_t i=0; i<configs.size(); i++) {
+    const SweepConfig &c = configs[i];
+    std::cout << std::setw(6) << i+1 << std::setw(10);
+    if (c.best)
+      std::cout << c.best;
+    else
+      std::cout << "-";
+    std::cout << std::setw(12) << c.ms << "  " << std::left << std::setw(width) << c.text << std::right << " ";
+    for (int j=0; j<boxNumAll; j++)
+      std::cout << " " << c.counts[j];
+    if (c.increaseNeeded)
+      std::cout << "  (increase maxSteps!!)";
+    std::cout << '\n';
+  }
+  std::cout << std::flush;
+
+#ifdef STATS
+  stats::collect();
+  std::string about = "\"program\": \"boxesCounting\", \"boxNum\": " + std::to_string(boxNumAll) + ", \"sweep\": true";
+  if (stats::dump(statsFile, about))
+    std::cout << "  wrote search statistics to " << statsFile << '\n' << std::flush;
+  stats::reset();
+#endif
+  if (useBounds)
+    bounds::report();
+
+  return true;
+}
+
+
+
+// Estimate the number of frames and the time that the search would take, for
+//   --estimate. Each probe starts at the root and goes down to a leaf, choosing a
+//   random child at each level among the ones that run() would enter, and the probes
+//   are added up as in estimate.h.
+// At each frame, every child is built with nextChild() and put back with
+//   childReturned(), just like run() does, and that is timed to give the frame's
+//   time. Then a random one of them is built again to go down to. best stays at
+//   --best (default 0) instead of rising as solutions are found, so give --best about
+//   the answer expected to estimate the real search.
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::estimate(int probes) {
+
+  std::mt19937 random(1);   // the same probes every time
+  estimate::Mean frames, seconds;
+  uint64_t countsBefore[maxBoxNumAll];
+  for (int i=0; i<boxNumAll; i++)
+    countsBefore[i] = counts[i];
+  resumeDepth = 0;
+
+  FrameArena arena;
+  initRoot(arena);
+  probe(arena, probes, random, frames, seconds);
+
+  for (int i=0; i<boxNumAll; i++)
+    counts[i] = countsBefore[i];
+
+  for (int i=0; i<boxNumAll; i++)
+    std::cout << " (" << isCounting[i] << "," << minStart[i] << ")";
+  std::cout << "\n  estimate for " << static_cast<unsigned>(boxNumAll) << " boxes from " << probes
+            << " probes, with best at " << best << '\n';
+  estimate::report(frames, seconds);
+
+}
+
+
+
+// Add probes starting at the root of arena, which initRoot() set up, to frames and
+//   seconds, for estimate() and balance(). The first levels follow prefix[]. counts[]
+//   is changed, so the callers put it back.
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::probe(FrameArena &arena, int probes, std::mt19937 &random,
+                                                 estimate::Mean &frames, estimate::Mean &seconds) {
+
+  for (int probe=0; probe<probes; probe++) {
+
+    double weight = 1;   // the estimated number of frames at this depth
+    double count = 1;
+    double time = 0;
+    int depth = 0;
+    while (true) {
+      Frame &f = arena.frame(depth);
+      Frame &child = arena.frame(depth+1);
+      nType n = f.n;
+
+      // the same checks as enterFrame()
+      if ((f.dead > n && f.dead < best+1) || n > maxSteps || f.dead == n)
+        break;
+      possType options = boxesOf(f, n);
+      if (depth < (int)prefix.size())
+        options &= (possType)1 << prefix[depth];
+
+      // all of the children
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      int children = 0;
+      f.options = options;
+      f.putInEmptyBox = false;
+      f.putInEmptyCountingBox = false;
+      while (nextChild(f, child, depth)) {
+        children++;
+        childReturned(f);
+      }
+      time += weight * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      if (!children)
+        break;
+
+      // go down to a random one of them
+      int pick = random() % children;
+      f.options = options;
+      f.putInEmptyBox = false;
+      f.putInEmptyCountingBox = false;
+      for (int c=0; c<=pick; c++) {
+        nextChild(f, child, depth);
+        if (c < pick)
+          childReturned(f);
+      }
+      weight *= children;
+      count += weight;
+      depth++;
+    }
+
+    // put boxes[] (and the trail) back the way they were at the root
+    for (int d = depth-1; d >= 0; d--)
+      childReturned(arena.frame(d));
+
+    frames.add(count);
+    seconds.add(time);
+  }
+
+}
+
+
+
+// Split the search below prefix[] into tasks that are each estimated to take no more
+//   than 1/tasks of the total time, for --balance. This replaces cutting at one depth
+//   with --generate, where some tasks finish at once and a few take almost all of the
+//   time.
+// The most expensive task is repeatedly replaced by its children (the boxes that
+//   nextChild() accepts at the next level), each of which is costed by balanceProbes
+//   probes (see probe()). A task that enterFrame() would stop at has no children and is
+//   kept as it is. The tasks are put in generated[] most expensive first, so that
+//   workers, which claim tasks in order of name, start the long ones first.
+
+template <uint8_t boxNumAll, class possType, class nType>
+void Counting<boxNumAll, possType, nType>::balance(int tasks) {
+
+  struct Task {
+    std::vector<int> path;   // the box tried at each level
+    double cost;             // estimated seconds
+    bool operator<(const Task &other) const { return cost < other.cost; }
+  };
+
+  std::mt19937 random(1);   // the same tasks every time
+  uint64_t countsBefore[maxBoxNumAll];
+  for (int i=0; i<boxNumAll; i++)
+    countsBefore[i] = counts[i];
+  resumeDepth = 0;
+
+  FrameArena arena;
+  initRoot(arena);
+
+  auto cost = [&](const std::vector<int> &task) {
+    prefix = task;
+    estimate::Mean frames, seconds;
+    probe(arena, balanceProbes, random, frames, seconds);
+    return seconds.mean;
+  };
+
+  // the boxes of the children of task, found by going down to it like run() would
+  auto children = [&](const std::vector<int> &task) {
+    std::vector<int> found;
+    prefix = task;
+    int depth = 0;
+    while (true) {
+      Frame &f = arena.frame(depth);
+      nType n = f.n;
+      if ((f.dead > n && f.dead < best+1) || n > maxSteps || f.dead == n)
+        break;
+      f.options = boxesOf(f, n);
+      if (depth < (int)task.size())
+        f.options &= (possType)1 << task[depth];
+      f.putInEmptyBox = false;
+      f.putInEmptyCountingBox = false;
+      if (depth == (int)task.size()) {
+        while (nextChild(f, arena.frame(depth+1), depth)) {
+          found.push_back(path[depth]);
+          childReturned(f);
+        }
+        break;
+      }
+      if (!nextChild(f, arena.frame(depth+1), depth))
+        break;
+      depth++;
+    }
+    for (int d = depth-1; d >= 0; d--)
+      childReturned(arena.frame(d));
+    return found;
+  };
+
+  std::vector<int> start = prefix;
+  std::priority_queue<Task> frontier;   // the most expensive on top
+  std::vector<Task> unsplittable;
+  Task first = {start, cost(start)};
+  frontier.push(first);
+  double total = first.cost;
+
+  // split until the most expensive task is no more than its share of the total
+  while (!frontier.empty() && frontier.top().cost > total / tasks) {
+    Task task = frontier.top();
+    frontier.pop();
+    total -= task.cost;
+
+    std::vector<int> boxesFound = children(task.path);
+    if (boxesFound.empty()) {
+      unsplittable.push_back(task);
+      continue;
+    }
+
+    for (size_t i=0; i<boxesFound.size(); i++) {
+      Task child = {task.path, 0};
+      child.path.push_back(boxesFound[i]);
+      child.cost = cost(child.path);
+      total += child.cost;
+      frontier.push(child);
+    }
+  }
+
+  prefix = start;
+  for (int i=0; i<boxNumAll; i++)
+    counts[i] = countsBefore[i];
+
+  std::vector<Task> all = unsplittable;
+  for (; !frontier.empty(); frontier.pop())
+    all.push_back(frontier.top());
+  std::sort(all.begin(), all.end(), [](const Task &a, const Task &b) { return a.cost > b.cost; });
+
+  for (size_t i=0; i<all.size(); i++) {
+    std::string state;
+    for (size_t j=0; j<all[i].path.size(); j++)
+      state += std::to_string(all[i].path[j]) + (j+1 < all[i].path.size() ? "," : "");
+    generated.push_back(state);
+  }
+
+  std::cout << "  " << all.size() << " tasks with an estimated " << estimate::duration(total) << " in total"
+            << ", from " << estimate::duration(all.empty() ? 0 : all.back().cost)
+            << " to " << estimate::duration(all.empty() ? 0 : all[0].cost) << " each\n" << std::flush;
+
+}
+
+
+
+int main(int argc, char* argv[]) {
+
+  int boxNumAll = 16;
+  const char *generateDir = nullptr;
+  const char *workerDir = nullptr;
+  const char *sweepFile = nullptr;
+  int staleSeconds = 600;
+  bool haveState = false;
+  for (int a=1; a<argc; a++) {
+    if (!strcmp(argv[a], "--boxes") && a+1 < argc) {
+      boxNumAll = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--counting") && a+1 < argc) {
+      parseSetting(argv[++a], isCounting);
+    } else if (!strcmp(argv[a], "--minStart") && a+1 < argc) {
+      parseSetting(argv[++a], minStart);
+    } else if (!strcmp(argv[a], "--maxStart") && a+1 < argc) {
+      parseSetting(argv[++a], maxStart);
+    } else if (!strcmp(argv[a], "--generate") && a+2 < argc) {
+      generateDir = argv[++a];
+      generateDepth = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--worker") && a+1 < argc) {
+      workerDir = argv[++a];
+    } else if (!strcmp(argv[a], "--stale") && a+1 < argc) {
+      staleSeconds = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--checkpoint") && a+1 < argc) {
+      checkpointFile = argv[++a];
+    } else if (!strcmp(argv[a], "--every") && a+1 < argc) {
+      checkpointSeconds = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--resume") && a+1 < argc) {
+      resumeFile = argv[++a];
+    } else if (!strcmp(argv[a], "--bench") && a+1 < argc) {
+      benchProbes = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--balance") && a+2 < argc) {
+      generateDir = argv[++a];
+      balanceTasks = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--estimate") && a+1 < argc) {
+      estimateProbes = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--best") && a+1 < argc) {
+      startBest = strtoul(argv[++a], nullptr, 10);
+    } else if (!strcmp(argv[a], "--solutions") && a+1 < argc) {
+      if (!solutions.open(argv[++a])) {
+        std::cout << "cannot write " << argv[a] << '\n' << std::flush;
+        return 1;
+      }
+    } else if (!strcmp(argv[a], "--bound")) {
+      useBounds = true;
+    } else if (!strcmp(argv[a], "--table") && a+1 < argc) {
+      if (!table.resize(atoi(argv[++a]))) {
+        std::cout << "cannot allocate " << argv[a] << " MB for --table\n" << std::flush;
+        return 1;
+      }
+    } else if (!strcmp(argv[a], "--replace") && a+1 < argc) {
+      transposition::Policy policy;
+      if (!transposition::parsePolicy(argv[++a], policy)) {
+        std::cout << "--replace must be always or bigger\n" << std::flush;
+        return 1;
+      }
+      table.setPolicy(policy);
+    } else if (!strcmp(argv[a], "--tableDepth") && a+1 < argc) {
+      tableDepth = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--forced")) {
+      forcing = true;
+    } else if (!strcmp(argv[a], "--sweep") && a+1 < argc) {
+      sweepFile = argv[++a];
+    } else if (!strcmp(argv[a], "--threads") && a+1 < argc) {
+      numThreads = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--split") && a+1 < argc) {
+      splitDepth = atoi(argv[++a]);
+    } else if (!strcmp(argv[a], "--stats") && a+1 < argc) {
+      statsFile = argv[++a];
+#ifndef STATS
+      std::cout << "  --stats does nothing unless STATS is defined\n" << std::flush;
+#endif
+    } else if (!strcmp(argv[a], "--simd") && a+1 < argc) {
+      simd::Level level;
+      if (!simd::parseLevel(argv[++a], level)) {
+        std::cout << "bad user! bad!\n" << std::flush;
+        return 1;
+      }
+      if (level > simd::cpuLevel()) {
+        std::cout << "--simd " << argv[a] << " needs " << simd::levelName(level) << ", but this CPU only has "
+                  << simd::levelName(simd::cpuLevel()) << '\n' << std::flush;
+        return 1;
+      }
+      simd::Kernels<uint8_t>::use(level);
+      simd::Kernels<uint16_t>::use(level);
+    } else if (argv[a][0] != '-' && !haveState) {
+      haveState = true;
+      prefix = parseState(argv[a]);
+    } else {
+      std::cout << "bad user! bad!\n" << std::flush;
+      return 1;
+    }
+  }
+
+
+  if (boxNumAll < 1 || boxNumAll > maxBoxNumAll) {
+    std::cout << "--boxes must be from 1 to " << (int)maxBoxNumAll << '\n' << std::flush;
+    return 1;
+  }
+
+
+  if ((!checkpointFile.empty() || !resumeFile.empty()) && (workerDir || generateDir)) {
+    std::cout << "checkpoints cannot be combined with --worker or --generate\n" << std::flush;
+    return 1;
+  }
+  if ((!checkpointFile.empty() || !resumeFile.empty()) && numThreads > 1 && !sweepFile) {
+    std::cout << "checkpoints cannot be combined with --threads\n" << std::flush;
+    return 1;
+  }
+
+
+  if (sweepFile) {
+    if (workerDir || generateDir || benchProbes || estimateProbes || haveState || table.enabled()
+        || !checkpointFile.empty() || !resumeFile.empty()) {
+      std::cout << "--sweep cannot be combined with --worker, --generate, --balance, --bench, --estimate, --table, checkpoints, or a starting state\n" << std::flush;
+      return 1;
+    }
+    if (!sweep(boxNumAll, sweepFile))
+      return 1;
+    return 0;
+  }
+
+
+  if (workerDir) {
+    jobFolder::runWorker(workerDir, staleSeconds, [boxNumAll](const std::string &content) {
+      prefix = parseState(content.c_str());
+      search(boxNumAll);
+    });
+    return 0;
+  }
+
+
+  search(boxNumAll);
+
+  if (generateDir) {
+    int written = jobFolder::writeTasks(generateDir, generated);
+    std::cout << "  wrote " << written << " tasks to " << generateDir << "/jobs\n" << std::flush;
+  }
+
 
   return 0;
 }
\ No newline at end of file
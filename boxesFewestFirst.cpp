@@ -0,0 +1,308 @@
+/*
+  Mess around with boxes.cpp first so that you can understand this file.
+
+  Instead of placing 1, then 2, then 3, etc., this code is given a target max number
+    and tries to place ALL of 1 through target. At each step, it places the number
+    that has the fewest boxes left in possibilities[] (ties are broken by the lowest
+    number). This does the easy parts of the search first so that the hard parts
+    are easier by the time they are started.
+  Every way of placing 1 through target is printed (up to shuffling the boxes),
+    followed by whether target+1 could then be placed, which is how we can check
+    whether boxesCounting.cpp's best can be beaten.
+
+  Because numbers are placed out of order, placing x in a box must remove...
+   - 2*x and, if x is even, x/2
+   - every new sum (the sums of x with the sets of numbers already in the box)
+   - every number z that would make a number y already in the box a sum, that is,
+     y = z + s where s is a sum of the box (now including the sums that contain x)
+  sums[box][] uses the same bitset layout as boxes.cpp. To find the y - s values
+    with bit shifts, each box also keeps rsums[box][], which is sums[box][] with the
+    bits in reversed order, and elements[box][], the numbers in the box.
+
+
+  To compile...
+    g++ -O3 -std=c++11 boxesFewestFirst.cpp
+  To run, give the target max number...
+    ./a.out 36
+  For 6 boxes, the idea is to run with a target of 156 (what boxesCounting.cpp finds),
+    then see if 157 can be placed in any of the resulting solutions.
+
+  Before compiling, set boxNum !
+*/
+
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+int target;                  // place all of 1 through target
+uint64_t solutionCount;
+uint64_t extendableCount;    // solutions in which target+1 could also be placed
+
+
+
+
+const uint8_t boxNum = 4;
+// not greater than 8 while possibilities is uint8_t
+
+
+
+/*
+  target can go up to maxSteps-1
+*/
+
+const uint16_t maxSteps = 3 << (uint16_t) boxNum;   // this seems safe
+
+const uint16_t sumsLength = ( maxSteps>>6 ) + 1;
+
+// bit position of the sum 0 in rsums[box][]
+const uint16_t reversedZero = (sumsLength << 6) - 1;
+
+const uint8_t unplaced = 0xff;
+
+
+
+// everything that changes when a number is placed
+struct State {
+  uint8_t possibilities[maxSteps+1];   // same as boxes.cpp, but tracked through target+1
+  uint8_t boxes[maxSteps+1];           // box of each number, or unplaced
+  uint64_t sums[boxNum][sumsLength];
+  uint64_t rsums[boxNum][sumsLength];  // bit reversedZero - s is set if s is a sum
+  uint64_t elements[boxNum][sumsLength];
+  int used;                            // the number of used boxes
+  int placed;                          // how many of 1 through target are placed
+};
+
+
+
+inline void setBit(uint64_t bits[sumsLength], int i) {
+  bits[i >> 6] |= ((uint64_t)1 << (i & 63));
+}
+
+// out |= in << shift
+inline void orShiftedUp(uint64_t out[sumsLength], const uint64_t in[sumsLength], int shift) {
+  int sdiv = shift >> 6;
+  int smod = shift & 63;
+  for (int i = sumsLength-1; i >= sdiv; i--) {
+    uint64_t word = in[i - sdiv] << smod;
+    if (smod && i - sdiv - 1 >= 0)   // smod=0 needs to be handled separately because of the undefined right bitshift
+      word |= in[i - sdiv - 1] >> (64 - smod);
+    out[i] |= word;
+  }
+}
+
+// out |= in >> shift
+inline void orShiftedDown(uint64_t out[sumsLength], const uint64_t in[sumsLength], int shift) {
+  int sdiv = shift >> 6;
+  int smod = shift & 63;
+  for (int i = 0; i + sdiv < sumsLength; i++) {
+    uint64_t word = in[i + sdiv] >> smod;
+    if (smod && i + sdiv + 1 < sumsLength)
+      word |= in[i + sdiv + 1] << (64 - smod);
+    out[i] |= word;
+  }
+}
+
+
+
+void printSolution(const State &state) {
+
+  // list the boxes in order of their smallest number, like the README does
+  std::vector<std::vector<int> > list(state.used);
+  for (int i=1; i<=target; i++)
+    list[state.boxes[i]].push_back(i);
+  std::sort(list.begin(), list.end());
+
+  std::cout << "[";
+  for (int j=0; j<boxNum; j++) {
+    std::cout << '[';
+    if (j < (int)list.size())
+      for (int i=0; i<(int)list[j].size(); i++)
+        std::cout << (i ? "," : "") << list[j][i];
+    std::cout << (j < boxNum-1 ? "], " : "]");
+  }
+  std::cout << ']';
+
+}
+
+
+
+// place x in box, updating everything else in state
+
+void place(State &state, int x, int box) {
+
+  uint8_t mask = ~((uint8_t)1 << box);
+  uint64_t *sums = state.sums[box];
+  uint64_t *rsums = state.rsums[box];
+
+  // the numbers that can no longer go in box
+  uint64_t forbidden[sumsLength] = {0};
+
+  // doubles and halves
+  if (2*x <= target+1)
+    setBit(forbidden, 2*x);
+  if (!(x & 1))
+    setBit(forbidden, x >> 1);
+
+  // z = x - s, so that x would be a sum, for the old sums s < x
+  orShiftedDown(forbidden, rsums, reversedZero - x);
+
+  // NEWsums are x plus the old sums, and x itself
+  uint64_t NEWsums[sumsLength] = {0};
+  orShiftedUp(NEWsums, sums, x);
+  setBit(NEWsums, x);
+  for (int i=0; i<sumsLength; i++) {
+    NEWsums[i] &= ~sums[i];
+    forbidden[i] |= NEWsums[i];
+  }
+
+  // same as NEWsums, but reversed
+  uint64_t NEWrsums[sumsLength] = {0};
+  orShiftedDown(NEWrsums, rsums, x);
+  setBit(NEWrsums, reversedZero - x);
+  for (int i=0; i<sumsLength; i++)
+    NEWrsums[i] &= ~rsums[i];
+
+  // z = y - s for the numbers y already in box and the NEWsums s < y
+  for (int i=0; i<sumsLength; i++) {
+    uint64_t temp = state.elements[box][i];
+    while (temp) {
+      int y = __builtin_ctzll(temp) + (i << 6);
+      orShiftedDown(forbidden, NEWrsums, reversedZero - y);
+      temp &= temp - 1;
+    }
+  }
+
+  // update sums, rsums, and elements
+  for (int i=0; i<sumsLength; i++) {
+    sums[i] |= NEWsums[i];
+    rsums[i] |= NEWrsums[i];
+  }
+  setBit(state.elements[box], x);
+
+  // remove forbidden from possibilities[]
+  forbidden[0] &= ~(uint64_t)1;   // 0 is not a number, and y - s = 0 means s = y
+  for (int i=0; i<sumsLength; i++) {
+    uint64_t temp = forbidden[i];
+    while (temp) {
+      int z = __builtin_ctzll(temp) + (i << 6);
+      if (z > target+1)
+        break;
+      state.possibilities[z] &= mask;
+      temp &= temp - 1;
+    }
+  }
+
+  state.boxes[x] = box;
+  state.placed++;
+  if (box == state.used)
+    state.used++;
+
+}
+
+
+
+// the recursive function
+
+void step(const State &state) {
+
+  if (state.placed == target) {
+    solutionCount++;
+    bool extendable = target+1 <= maxSteps && state.possibilities[target+1];
+    if (extendable)
+      extendableCount++;
+    std::cout << target << '\n';
+    printSolution(state);
+    std::cout << "\n" << target+1 << (extendable ? " can" : " cannot") << " be placed\n\n" << std::flush;
+    return;
+  }
+
+  // the boxes that can be chosen: any used box, and only the first empty box
+  //   (placing in a later empty box would only rename boxes)
+  uint8_t allowed = (uint8_t)((1 << state.used) - 1);
+  if (state.used < boxNum)
+    allowed |= (uint8_t)1 << state.used;
+
+  // find the number with the fewest options (ties are broken by the lowest number)
+  int x = 0;
+  int fewest = boxNum + 1;
+  for (int i=1; i<=target; i++) {
+    if (state.boxes[i] != unplaced)
+      continue;
+    int options = __builtin_popcount(state.possibilities[i] & allowed);
+    if (options < fewest) {
+      fewest = options;
+      x = i;
+      if (options == 0)   // dead end, so no need to look further
+        break;
+    }
+  }
+  if (fewest == 0)
+    return;   // x cannot be placed anywhere
+
+  uint8_t options = state.possibilities[x] & allowed;
+  while (options) {
+    int box = __builtin_ctz(options);
+    options &= options - 1;
+
+    State stateNew = state;
+    place(stateNew, x, box);
+    step(stateNew);
+  }
+
+}
+
+
+
+int main(int argc, char* argv[]) {
+
+  if (argc != 2) {
+    std::cout << "bad user! bad! Give the target max number.\n" << std::flush;
+    return 1;
+  }
+  target = atoi(argv[1]);
+  if (target < 1 || target >= maxSteps) {
+    std::cout << "target must be from 1 to " << maxSteps-1 << " (increase boxNum or maxSteps)\n" << std::flush;
+    return 1;
+  }
+
+  solutionCount = 0;
+  extendableCount = 0;
+
+
+  /* initialize data structures */
+
+  State state;
+  for (int i=0; i<=maxSteps; i++) {
+    state.possibilities[i] = (1 << boxNum) - 1;   // each bit is a box
+    state.boxes[i] = unplaced;
+  }
+  for (int i=0; i<boxNum; i++)
+    for (int j=0; j<sumsLength; j++) {
+      state.sums[i][j] = 0;
+      state.rsums[i][j] = 0;
+      state.elements[i][j] = 0;
+    }
+  state.used = 0;
+  state.placed = 0;
+
+
+
+  // start timer
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  // do it
+  step(state);
+
+  // stop timer
+  long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+  // print
+  std::cout << "  " << solutionCount << " ways to place 1 through " << target << ", and " << target+1
+            << " can be placed in " << extendableCount << " of them\n";
+  std::cout << "  time for " << static_cast<unsigned>(boxNum) << " boxes is " << duration_ms << " ms\n" << std::flush;
+
+  return 0;
+}
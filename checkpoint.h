@@ -0,0 +1,155 @@
+/*
+  Periodic checkpoints for long searches.
+
+  A checkpoint is a small text file of "key value" lines, for example...
+    best 73
+    path 0,1,0,2,1,2,2,0
+  It is written to a temporary file that is then renamed over the old checkpoint,
+    so a reboot in the middle of writing never destroys the previous checkpoint.
+    The temporary file is synced to the disk before the rename, and the folder after
+    it, since otherwise a crash soon after can leave the new name on an empty file.
+
+  The search itself decides what to save. Timer just sets a flag every so many
+    seconds, so the only cost inside the search is checking that flag.
+*/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif
+
+
+namespace checkpoint {
+
+
+typedef std::map<std::string, std::string> Fields;
+
+
+// sets due to true every intervalSeconds until destroyed
+class Timer {
+public:
+  Timer(int intervalSeconds, std::atomic<bool> &due) : interval(intervalSeconds < 1 ? 1 : intervalSeconds), due(due), stopping(false) {
+    thread = std::thread(&Timer::loop, this);
+  }
+  ~Timer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+  }
+private:
+  int interval;
+  std::atomic<bool> &due;
+  bool stopping;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::thread thread;
+  void loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!condition.wait_for(lock, std::chrono::seconds(interval), [this]() { return stopping; }))
+      due = true;
+  }
+};
+
+
+// Make the contents of path reach the disk. fsync() flushes the file, not just the
+//   descriptor, so the file can be closed by whoever wrote it first.
+inline bool syncFile(const std::string &path) {
+#ifdef _WIN32
+  (void)path;   // MoveFileEx without MOVEFILE_WRITE_THROUGH gives no such promise anyway
+  return true;
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+#endif
+}
+
+// make a rename() into the folder of path reach the disk
+inline bool syncFolderOf(const std::string &path) {
+  size_t slash = path.rfind('/');
+  return syncFile(slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash));
+}
+
+
+inline bool save(const std::string &file, const Fields &fields) {
+  std::string tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp.c_str());
+    if (!out)
+      return false;
+    for (Fields::const_iterator it = fields.begin(); it != fields.end(); ++it)
+      out << it->first << ' ' << it->second << '\n';
+    out.flush();
+    if (!out)
+      return false;
+  }
+  if (!syncFile(tmp) || rename(tmp.c_str(), file.c_str()) != 0)
+    return false;
+  syncFolderOf(file);
+  return true;
+}
+
+
+inline bool load(const std::string &file, Fields &fields) {
+  std::ifstream in(file.c_str());
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t space = line.find(' ');
+    if (space == std::string::npos)
+      fields[line] = "";
+    else
+      fields[line.substr(0, space)] = line.substr(space+1);
+  }
+  return true;
+}
+
+
+// comma-separated lists, such as the path of boxes
+
+template <class T>
+std::string join(const T *values, int count) {
+  std::ostringstream out;
+  for (int i=0; i<count; i++)
+    out << (i ? "," : "") << (long long)values[i];
+  return out.str();
+}
+
+inline std::vector<long long> split(const std::string &text) {
+  std::vector<long long> values;
+  std::istringstream in(text);
+  std::string item;
+  while (std::getline(in, item, ','))
+    if (!item.empty())
+      values.push_back(atoll(item.c_str()));
+  return values;
+}
+
+
+}  // namespace checkpoint
+
+
+#endif
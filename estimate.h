@@ -0,0 +1,86 @@
+/*
+  Adding up random probes into an estimate of the size of a search, for --estimate.
+
+  This is Knuth's estimate of the size of a tree (Mathematics of Computation, 1975).
+    A probe goes from the root down to a leaf, picking a random child at each node. If
+    the nodes along the way had d1, d2, d3, ... children, then there are about d1 nodes
+    at the first level below the root, d1*d2 at the next, and so on, so the probe
+    estimates 1 + d1 + d1*d2 + ... nodes. The same weights times the time each node
+    took estimate the time. Each probe is an unbiased estimate, so their mean is too.
+  The interval is the mean plus or minus 1.96 standard errors. Search trees are
+    lopsided, and a few probes that happen to go down a huge subtree can move the mean
+    a lot, so when the interval is wide, or when more probes keep moving it, take it
+    as a rough guess.
+*/
+
+#ifndef ESTIMATE_H
+#define ESTIMATE_H
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+
+namespace estimate {
+
+
+// the mean of some probes, and how sure it is
+class Mean {
+public:
+  Mean() : count(0), mean(0), squares(0) {}
+
+  void add(double x) {   // Welford's method, since the estimates can be huge
+    count++;
+    double delta = x - mean;
+    mean += delta / count;
+    squares += delta * (x - mean);
+  }
+
+  // half of the width of the 95% interval
+  double halfWidth() const {
+    return count > 1 ? 1.96 * std::sqrt(squares / (count - 1) / count) : 0;
+  }
+
+  long long count;
+  double mean;
+  double squares;
+};
+
+
+inline std::string number(double x) {
+  char text[32];
+  std::snprintf(text, sizeof(text), x < 1e6 ? "%.0f" : "%.3g", x);
+  return text;
+}
+
+inline std::string duration(double seconds) {
+  char text[32];
+  if (seconds < 120)
+    std::snprintf(text, sizeof(text), "%.3g seconds", seconds);
+  else if (seconds < 2*3600)
+    std::snprintf(text, sizeof(text), "%.3g minutes", seconds / 60);
+  else if (seconds < 2*86400)
+    std::snprintf(text, sizeof(text), "%.3g hours", seconds / 3600);
+  else if (seconds < 2*31557600)
+    std::snprintf(text, sizeof(text), "%.3g days", seconds / 86400);
+  else
+    std::snprintf(text, sizeof(text), "%.3g years", seconds / 31557600);
+  return text;
+}
+
+
+inline void report(const Mean &nodes, const Mean &seconds) {
+  double low = nodes.mean - nodes.halfWidth();
+  std::cout << "  nodes  " << number(nodes.mean) << "   (95% interval " << number(low > 0 ? low : 0)
+            << " to " << number(nodes.mean + nodes.halfWidth()) << ")\n";
+  low = seconds.mean - seconds.halfWidth();
+  std::cout << "  time   " << duration(seconds.mean) << "   (95% interval " << duration(low > 0 ? low : 0)
+            << " to " << duration(seconds.mean + seconds.halfWidth()) << ") on one thread\n" << std::flush;
+}
+
+
+}  // namespace estimate
+
+
+#endif
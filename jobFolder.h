@@ -0,0 +1,328 @@
+/*
+  The jobs/claimed/done folder protocol from the README, for spreading a search
+    over many processes and computers that share a directory.
+
+    DIR/jobs/      one small file per task, each holding a starting state
+    DIR/claimed/   tasks being run, renamed to  <task>@<host>@<pid>
+    DIR/done/      finished tasks
+    DIR/output/    what each task printed, as <task>.txt
+
+  A worker claims a task by renaming it from jobs/ to claimed/. rename() is
+    atomic, so if two workers try to claim the same file, exactly one succeeds and
+    the other just tries the next file. Faster cores and easier tasks simply claim
+    more files, which is the dynamic load balancing.
+  While a task runs, the worker touches its claimed file every staleSeconds/4
+    seconds. A claimed file that has not been touched for staleSeconds, or whose
+    worker was on this host and no longer exists, was left by a crashed worker
+    and is moved back to jobs/ so that another worker can run it.
+  Output is written to a temporary name and renamed into output/ only once the
+    task finishes, so output/ never holds a partial result.
+
+  Workers keep going until jobs/ and claimed/ are both empty, so a crashed
+    worker's task still gets run by someone once it goes stale.
+*/
+
+#ifndef JOB_FOLDER_H
+#define JOB_FOLDER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <utime.h>
+
+#include "checkpoint.h"
+
+#ifdef _WIN32
+  #include <process.h>
+  #include <direct.h>
+#else
+  #include <signal.h>
+  #include <unistd.h>
+#endif
+
+
+namespace jobFolder {
+
+
+inline bool makeDir(const std::string &path) {
+#ifdef _WIN32
+  return _mkdir(path.c_str()) == 0;
+#else
+  return mkdir(path.c_str(), 0777) == 0;
+#endif
+}
+
+inline int processId() {
+#ifdef _WIN32
+  return _getpid();
+#else
+  return (int)getpid();
+#endif
+}
+
+inline std::string hostName() {
+  char name[256] = "host";
+#ifdef _WIN32
+  const char *env = getenv("COMPUTERNAME");
+  if (env)
+    snprintf(name, sizeof(name), "%s", env);
+#else
+  gethostname(name, sizeof(name));
+  name[sizeof(name)-1] = '\0';
+#endif
+  std::string s(name);
+  for (size_t i=0; i<s.size(); i++)   // '@' separates the fields of a claimed name
+    if (s[i] == '@' || s[i] == '/')
+      s[i] = '_';
+  return s;
+}
+
+inline bool processAlive(int pid) {
+#ifdef _WIN32
+  (void)pid;
+  return true;   // cannot tell, so rely on the heartbeat
+#else
+  return kill(pid, 0) == 0 || errno != ESRCH;
+#endif
+}
+
+inline std::vector<std::string> listDir(const std::string &path) {
+  std::vector<std::string> names;
+  DIR *dir = opendir(path.c_str());
+  if (!dir)
+    return names;
+  while (struct dirent *entry = readdir(dir)) {
+    std::string name(entry->d_name);
+    if (name.empty() || name[0] == '.')   // skips ".", "..", and temporary files
+      continue;
+    names.push_back(name);
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());   // so tasks are claimed in the order they were written
+  return names;
+}
+
+inline bool readFile(const std::string &path, std::string &content) {
+  std::ifstream in(path.c_str());
+  if (!in)
+    return false;
+  std::stringstream buffer;
+  buffer << in.rdbuf();
+  content = buffer.str();
+  return true;
+}
+
+// write to a hidden temporary file, then rename, so that readers never see a partial file,
+//   syncing like checkpoint::save() so that a crash cannot leave an empty one either
+inline bool writeFileAtomic(const std::string &dir, const std::string &name, const std::string &content) {
+  std::string tmp = dir + "/." + name + ".tmp" + std::to_string(processId());
+  {
+    std::ofstream out(tmp.c_str());
+    if (!out)
+      return false;
+    out << content;
+    out.flush();
+    if (!out)
+      return false;
+  }
+  if (!checkpoint::syncFile(tmp) || rename(tmp.c_str(), (dir + "/" + name).c_str()) != 0)
+    return false;
+  checkpoint::syncFile(dir);
+  return true;
+}
+
+
+// create DIR and its subfolders (fine if they exist already)
+inline void createLayout(const std::string &dir) {
+  makeDir(dir);
+  makeDir(dir + "/jobs");
+  makeDir(dir + "/claimed");
+  makeDir(dir + "/done");
+  makeDir(dir + "/output");
+}
+
+// the number after the highest task anywhere in DIR, so that tasks added to a folder
+//   that was used before never overwrite its tasks or their output
+inline unsigned nextTaskNumber(const std::string &dir) {
+  const char *folders[] = {"/jobs", "/claimed", "/done", "/output"};
+  unsigned next = 0;
+  for (int f=0; f<4; f++) {
+    std::vector<std::string> names = listDir(dir + folders[f]);
+    for (size_t i=0; i<names.size(); i++) {
+      unsigned number;
+      if (sscanf(names[i].c_str(), "task%u", &number) == 1 && number >= next)
+        next = number + 1;
+    }
+  }
+  return next;
+}
+
+// write tasks as jobs/task000000, jobs/task000001, ... with one starting state per file,
+//   numbered after any tasks that DIR already has
+inline int writeTasks(const std::string &dir, const std::vector<std::string> &states) {
+  createLayout(dir);
+  unsigned first = nextTaskNumber(dir);
+  if (first)
+    std::cout << dir << " already has tasks, so the new ones are numbered from " << first << '\n';
+  int written = 0;
+  for (size_t i=0; i<states.size(); i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "task%06u", first + (unsigned)i);
+    if (writeFileAtomic(dir + "/jobs", name, states[i] + "\n"))
+      written++;
+    else
+      std::cout << "could not write " << dir << "/jobs/" << name << '\n';
+  }
+  return written;
+}
+
+
+// Move tasks of crashed workers from claimed/ back to jobs/.
+// Returns how many tasks are still claimed by (apparently) live workers.
+inline int recoverStale(const std::string &dir, int staleSeconds) {
+  std::string host = hostName();
+  std::vector<std::string> claimed = listDir(dir + "/claimed");
+  int live = 0;
+  for (size_t i=0; i<claimed.size(); i++) {
+    std::string path = dir + "/claimed/" + claimed[i];
+    size_t at1 = claimed[i].find('@');
+    size_t at2 = claimed[i].rfind('@');
+    if (at1 == std::string::npos || at1 == at2)
+      continue;
+    std::string task = claimed[i].substr(0, at1);
+    std::string taskHost = claimed[i].substr(at1+1, at2-at1-1);
+    int taskPid = atoi(claimed[i].c_str() + at2 + 1);
+
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+      continue;   // finished or recovered by someone else in the meantime
+    bool stale = difftime(time(nullptr), info.st_mtime) > staleSeconds;
+    if (taskHost == host && !processAlive(taskPid))
+      stale = true;
+
+    if (stale && rename(path.c_str(), (dir + "/jobs/" + task).c_str()) == 0)
+      std::cout << "recovered " << task << " from " << claimed[i] << '\n' << std::flush;
+    else
+      live++;
+  }
+  return live;
+}
+
+
+// Try to claim one task. On success, fills in the task name, the claimed path, and the content.
+inline bool claim(const std::string &dir, std::string &task, std::string &claimedPath, std::string &content) {
+  std::string suffix = "@" + hostName() + "@" + std::to_string(processId());
+  std::vector<std::string> jobs = listDir(dir + "/jobs");
+  for (size_t i=0; i<jobs.size(); i++) {
+    std::string from = dir + "/jobs/" + jobs[i];
+    std::string to = dir + "/claimed/" + jobs[i] + suffix;
+    // The heartbeat starts now, not when the task was written. rename() keeps the time,
+    //   so it is touched first, or recoverStale() could find it stale once it is claimed.
+    if (utime(from.c_str(), nullptr) != 0)
+      continue;   // claimed by someone else in the meantime
+    if (rename(from.c_str(), to.c_str()) == 0) {   // atomic, so only one worker wins
+      task = jobs[i];
+      claimedPath = to;
+      return readFile(to, content);
+    }
+  }
+  return false;
+}
+
+
+// Touches the claimed file every interval so that other workers know this task is alive.
+class Heartbeat {
+public:
+  Heartbeat(const std::string &path, int intervalSeconds) : path(path), interval(intervalSeconds < 1 ? 1 : intervalSeconds), stopping(false) {
+    thread = std::thread(&Heartbeat::loop, this);
+  }
+  ~Heartbeat() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    thread.join();
+  }
+private:
+  std::string path;
+  int interval;
+  bool stopping;
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::thread thread;
+  void loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!condition.wait_for(lock, std::chrono::seconds(interval), [this]() { return stopping; }))
+      utime(path.c_str(), nullptr);
+  }
+};
+
+
+/*
+  Claim and run tasks until there are none left.
+  run(content) does the actual search; everything it prints to std::cout goes
+    to DIR/output/<task>.txt instead.
+*/
+template <class Run>
+int runWorker(const std::string &dir, int staleSeconds, Run run) {
+
+  createLayout(dir);
+  int tasksRun = 0;
+
+  while (true) {
+
+    std::string task, claimedPath, content;
+    if (!claim(dir, task, claimedPath, content)) {
+      if (recoverStale(dir, staleSeconds) == 0 && listDir(dir + "/jobs").empty())
+        break;   // nothing queued and nobody else working
+      if (listDir(dir + "/jobs").empty())
+        std::this_thread::sleep_for(std::chrono::seconds(staleSeconds < 20 ? 1 : 5));
+      continue;
+    }
+
+    std::cout << "running " << task << ": " << content << std::flush;
+
+    std::string outName = task + ".txt";
+    std::string outTmp = dir + "/output/." + outName + ".tmp" + std::to_string(processId());
+    {
+      Heartbeat heartbeat(claimedPath, staleSeconds/4);
+      std::ofstream out(outTmp.c_str());
+      std::streambuf *coutBuffer = std::cout.rdbuf(out.rdbuf());
+      run(content);
+      std::cout << std::flush;
+      std::cout.rdbuf(coutBuffer);
+    }
+    checkpoint::syncFile(outTmp);
+    rename(outTmp.c_str(), (dir + "/output/" + outName).c_str());
+
+    if (rename(claimedPath.c_str(), (dir + "/done/" + task).c_str()) != 0)
+      std::cout << "  " << task << " was recovered by another worker while running, so it may run twice\n";
+    tasksRun++;
+  }
+
+  std::cout << "worker done after " << tasksRun << " tasks\n" << std::flush;
+  return tasksRun;
+}
+
+
+}  // namespace jobFolder
+
+
+#endif
@@ -0,0 +1,420 @@
+/*
+  Find the solutions that boxesCounting.cpp did not print because of its counting-box
+    assumptions, and see whether any of them can be extended by one more number.
+
+  Give it the output of boxesCounting.cpp, or anything else holding solutions in the
+    format of printBoxes(), such as [[1,4], [2,3], [5,0,9]] (a,0,b is every number
+    from a to b, the way boxesCounting.cpp prints counting boxes)...
+    g++ -O3 -std=c++11 recover.cpp -o recover
+    ./recover log6.txt
+  or pipe it in with ./recover < log6.txt. Everything outside the [[...]] is ignored.
+
+  For each solution, which must hold each of 1 through N exactly once, it
+   - checks that each box is valid, by rebuilding the bitset of the sums of each box
+     like sums[box][] in boxes.cpp,
+   - tries moving each number on its own into every other box, and lists each move
+     that gives another valid solution for N, and
+   - says whether N+1 can then be placed in some box, for the solution itself and
+     for each solution given by a move.
+  Numbers in a row that move between the same two boxes with the same result are
+    listed as one line, since a whole counting-box interval can often move.
+  With --print (./recover --print log6.txt), the solution given by each move is also
+    printed in the same format, so the output can be given to recover again to find
+    solutions that need two moves, and so on.
+  This is what the README's Python script did for the 6-box results (3 solutions for
+    156 becoming at least 7), but fast enough for the 16-box solutions of 175340.
+
+  Taking x out of a box can never make that box invalid, so a move of x into box B is
+    valid if and only if...
+   - x is not a sum of B,
+   - neither 2x nor x/2 is in B, and
+   - no y > x in B is x plus a sum of B.
+  With sums[] and the numbers of B as bitsets, the last is an AND of sums[] with the
+    numbers of B shifted down by x, and it usually stops at the first few words.
+  N+1 can go in a box if it is not a sum of the box and (N+1)/2 is not in the box.
+    After a move, the box that x went to has the sums of B plus x added to them. For
+    the box that x left, if N+1 was a sum of it, sumsWithout() finds for every number
+    of the box at once whether N+1 is still a sum without that number.
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+
+typedef std::vector<uint64_t> Bits;   // bit i is the number i
+
+int bitsLength;   // words in each Bits, enough for 0 through N+1
+
+
+
+inline bool has(const Bits &bits, long long i) {
+  return i >= 0 && i < ((long long)bitsLength << 6) && ((bits[i >> 6] >> (i & 63)) & 1);
+}
+
+inline void setBit(Bits &bits, long long i) {
+  if (i >= 0 && i < ((long long)bitsLength << 6))
+    bits[i >> 6] |= ((uint64_t)1 << (i & 63));
+}
+
+// bits |= bits << shift, going from the top down so that it can be done in place
+inline void orShiftedUp(Bits &bits, int shift) {
+  int sdiv = shift >> 6;
+  int smod = shift & 63;
+  for (int i = bitsLength-1; i >= sdiv; i--) {
+    uint64_t word = bits[i - sdiv] << smod;
+    if (smod && i - sdiv - 1 >= 0)   // smod=0 needs to be handled separately because of the undefined right bitshift
+      word |= bits[i - sdiv - 1] >> (64 - smod);
+    bits[i] |= word;
+  }
+}
+
+
+
+struct Box {
+  std::vector<int> numbers;   // in increasing order
+  Bits elements;              // the numbers as a bitset
+  Bits sums;                  // every sum of a nonempty set of the numbers, up to N+1
+  bool valid;
+};
+
+// Rebuild elements and sums, placing the numbers in increasing order as the search
+//   does, so a number that is a sum of the earlier ones (or double one) makes the box invalid.
+void rebuild(Box &box) {
+  box.elements.assign(bitsLength, 0);
+  box.sums.assign(bitsLength, 0);
+  box.valid = true;
+  for (size_t i=0; i<box.numbers.size(); i++) {
+    int x = box.numbers[i];
+    if (has(box.sums, x) || (x % 2 == 0 && has(box.elements, x/2)))
+      box.valid = false;
+    orShiftedUp(box.sums, x);
+    setBit(box.sums, x);
+    setBit(box.elements, x);
+  }
+}
+
+// can x (not already in box) be added to box?
+bool canAdd(const Box &box, int x) {
+
+  if (has(box.sums, x) || has(box.elements, 2*(long long)x) || (x % 2 == 0 && has(box.elements, x/2)))
+    return false;
+
+  // is some y > x in the box x plus a sum? That is, elements >> x overlaps sums
+  int sdiv = x >> 6;
+  int smod = x & 63;
+  for (int i = 0; i + sdiv < bitsLength; i++) {
+    uint64_t word = box.elements[i + sdiv] >> smod;
+    if (smod && i + sdiv + 1 < bitsLength)
+      word |= box.elements[i + sdiv + 1] << (64 - smod);
+    if (word & box.sums[i])
+      return false;
+  }
+  return true;
+}
+
+// can next, which is more than every number in the box, be added to box?
+bool canPlace(const Box &box, int next) {
+  return !has(box.sums, next) && !(next % 2 == 0 && has(box.elements, next/2));
+}
+
+
+
+// For each i, whether next is a sum of the numbers other than numbers[i]. This is for
+//   finding whether next fits in a box after a move takes a number out of it, without
+//   rebuilding the sums of a box of thousands of numbers for every move.
+// sums holds the sums (including 0) of the numbers outside of numbers[l..r]. Each half
+//   is given the sums with the other half added, so each number is added about
+//   log2(numbers.size()) times. Once next is a sum without any of numbers[l..r], it is
+//   a sum without each of them, which usually ends the recursion early.
+void sumsWithout(const std::vector<int> &numbers, int l, int r, const Bits &sums, int next, std::vector<char> &result) {
+  if (has(sums, next)) {
+    for (int i=l; i<=r; i++)
+      result[i] = true;
+    return;
+  }
+  if (l == r) {
+    result[l] = false;
+    return;
+  }
+  int mid = (l + r) / 2;
+  Bits half = sums;
+  for (int i=mid+1; i<=r; i++)
+    orShiftedUp(half, numbers[i]);
+  sumsWithout(numbers, l, mid, half, next, result);
+  half = sums;
+  for (int i=l; i<=mid; i++)
+    orShiftedUp(half, numbers[i]);
+  sumsWithout(numbers, mid+1, r, half, next, result);
+}
+
+
+
+// Print boxes like printBoxes() in boxesCounting.cpp, but with x moved to box to, and
+//   with each run of at least 3 numbers written as a,0,b.
+void printMoved(const std::vector<Box> &boxes, int x, int to) {
+  std::vector<int> list;
+  std::cout << "[";
+  for (size_t j=0; j<boxes.size(); j++) {
+    list.clear();
+    for (size_t i=0; i<boxes[j].numbers.size(); i++)
+      if (boxes[j].numbers[i] != x)
+        list.push_back(boxes[j].numbers[i]);
+    if ((int)j == to)
+      list.insert(std::upper_bound(list.begin(), list.end(), x), x);
+    std::cout << '[';
+    for (size_t i=0; i<list.size(); ) {
+      size_t end = i;
+      while (end+1 < list.size() && list[end+1] == list[end]+1)
+        end++;
+      std::cout << (i ? "," : "");
+      if (end - i >= 2) {
+        std::cout << list[i] << ",0," << list[end];
+        i = end+1;
+      } else {
+        std::cout << list[i];
+        i++;
+      }
+    }
+    std::cout << (j+1 < boxes.size() ? "], " : "]");
+  }
+  std::cout << "]\n";
+}
+
+
+
+// Read the next [[...], [...], ...] from in. Returns false at the end of in.
+bool readSolution(std::istream &in, std::vector<std::vector<int> > &numbers) {
+
+  numbers.clear();
+  int depth = 0;
+  std::vector<long long> tokens;
+  long long value = -1;   // -1 while not reading a number
+  char c;
+  while (in.get(c)) {
+    if (c == '[') {
+      depth++;
+      if (depth == 2)
+        tokens.clear();
+    } else if (depth == 2 && c >= '0' && c <= '9') {
+      value = (value < 0 ? 0 : 10*value) + (c - '0');
+      continue;
+    } else if (depth >= 1 && c == ']') {
+      if (depth == 2) {
+        if (value >= 0)
+          tokens.push_back(value);
+        // expand a,0,b
+        std::vector<int> list;
+        for (size_t i=0; i<tokens.size(); i++) {
+          if (tokens[i] == 0 && i > 0 && i+1 < tokens.size()) {
+            for (long long x = tokens[i-1]+1; x <= tokens[i+1]; x++)
+              list.push_back((int)x);
+            i++;
+          } else {
+            list.push_back((int)tokens[i]);
+          }
+        }
+        numbers.push_back(list);
+      }
+      depth--;
+      if (depth == 0)
+        return true;
+    }
+    if (depth == 2 && value >= 0)
+      tokens.push_back(value);
+    value = -1;
+  }
+  return false;
+}
+
+
+
+struct Move {
+  int x, from, to;
+  std::vector<int> fitsAfter;   // the boxes that N+1 can go in after the move
+  bool operator<(const Move &other) const {
+    if (from != other.from)
+      return from < other.from;
+    if (to != other.to)
+      return to < other.to;
+    return x < other.x;
+  }
+};
+
+
+
+int main(int argc, char* argv[]) {
+
+  bool printSolutions = false;
+  const char *fileName = nullptr;
+  for (int a=1; a<argc; a++) {
+    if (!strcmp(argv[a], "--print")) {
+      printSolutions = true;
+    } else if (argv[a][0] != '-' && !fileName) {
+      fileName = argv[a];
+    } else {
+      std::cout << "bad user! bad! Give a file of solutions, or pipe them in.\n" << std::flush;
+      return 1;
+    }
+  }
+
+  std::ifstream file;
+  if (fileName) {
+    file.open(fileName);
+    if (!file) {
+      std::cout << "cannot read " << fileName << '\n' << std::flush;
+      return 1;
+    }
+  }
+  std::istream &in = fileName ? file : std::cin;
+
+  // start timer
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  long long solutions = 0, moves = 0, extendable = 0;
+  std::vector<std::vector<int> > numbers;
+  while (readSolution(in, numbers)) {
+    solutions++;
+
+    // each of 1 through N exactly once
+    int N = 0;
+    for (size_t j=0; j<numbers.size(); j++)
+      for (size_t i=0; i<numbers[j].size(); i++)
+        if (numbers[j][i] > N)
+          N = numbers[j][i];
+    std::vector<int> boxOf(N+1, -1);
+    bool complete = true;
+    for (size_t j=0; j<numbers.size(); j++)
+      for (size_t i=0; i<numbers[j].size(); i++) {
+        int x = numbers[j][i];
+        if (x < 1 || boxOf[x] >= 0)
+          complete = false;
+        else
+          boxOf[x] = j;
+      }
+    for (int x=1; x<=N; x++)
+      if (boxOf[x] < 0)
+        complete = false;
+    std::cout << "solution " << solutions << ": 1 to " << N << " in " << numbers.size() << " boxes\n";
+    if (!complete) {
+      std::cout << "  skipped, since it does not hold each of 1 to " << N << " exactly once\n\n" << std::flush;
+      continue;
+    }
+
+    bitsLength = ((N+1) >> 6) + 1;
+    std::vector<Box> boxes(numbers.size());
+    bool valid = true;
+    for (size_t j=0; j<boxes.size(); j++) {
+      boxes[j].numbers = numbers[j];
+      std::sort(boxes[j].numbers.begin(), boxes[j].numbers.end());
+      rebuild(boxes[j]);
+      if (!boxes[j].valid) {
+        std::cout << "  box " << j << " is not valid\n";
+        valid = false;
+      }
+    }
+    if (!valid) {
+      std::cout << '\n' << std::flush;
+      continue;
+    }
+
+    // can N+1 be placed?
+    std::vector<bool> fits(boxes.size());
+    bool anyFits = false;
+    for (size_t j=0; j<boxes.size(); j++) {
+      fits[j] = canPlace(boxes[j], N+1);
+      if (fits[j]) {
+        std::cout << "  " << N+1 << " can go in box " << j << '\n';
+        anyFits = true;
+      }
+    }
+    if (anyFits)
+      extendable++;
+    else
+      std::cout << "  " << N+1 << " cannot be placed\n";
+
+    // every move of one number into another box
+    std::vector<Move> found;
+    std::vector<std::vector<char> > stillSum(boxes.size());   // [box][i]: is N+1 a sum of box without numbers[i]? (only found if needed)
+    for (int x=1; x<=N; x++) {
+      int from = boxOf[x];
+      for (int to=0; to<(int)boxes.size(); to++) {
+        if (to == from || !canAdd(boxes[to], x))
+          continue;
+        moves++;
+
+        // can N+1 be placed after the move?
+        std::vector<int> fitsAfter;
+        for (int j=0; j<(int)boxes.size(); j++) {
+          bool fit;
+          if (j == to) {
+            const Box &box = boxes[to];
+            fit = fits[to] && !has(box.sums, N+1-x) && x != N+1 && !(N % 2 == 1 && x == (N+1)/2);
+          } else if (j == from && !fits[from]) {
+            const Box &box = boxes[from];
+            if (stillSum[from].empty()) {
+              stillSum[from].resize(box.numbers.size());
+              Bits zero(bitsLength, 0);
+              setBit(zero, 0);
+              sumsWithout(box.numbers, 0, (int)box.numbers.size() - 1, zero, N+1, stillSum[from]);
+            }
+            int i = std::lower_bound(box.numbers.begin(), box.numbers.end(), x) - box.numbers.begin();
+            fit = !stillSum[from][i] && !(N % 2 == 1 && x != (N+1)/2 && has(box.elements, (N+1)/2));
+          } else {
+            fit = fits[j];
+          }
+          if (fit)
+            fitsAfter.push_back(j);
+        }
+
+        if (!fitsAfter.empty())
+          extendable++;
+        Move move = {x, from, to, fitsAfter};
+        found.push_back(move);
+      }
+    }
+
+    // list the moves, with a run of numbers that move between the same boxes with the same result on one line
+    std::sort(found.begin(), found.end());
+    for (size_t m=0; m<found.size(); ) {
+      size_t end = m;
+      while (end+1 < found.size() && found[end+1].from == found[m].from && found[end+1].to == found[m].to
+             && found[end+1].x == found[end].x + 1 && found[end+1].fitsAfter == found[m].fitsAfter)
+        end++;
+      if (end > m)
+        std::cout << "  moving any one of " << found[m].x << " to " << found[end].x;
+      else
+        std::cout << "  moving " << found[m].x;
+      std::cout << " from box " << found[m].from << " to box " << found[m].to << " gives another solution, where ";
+      if (found[m].fitsAfter.empty()) {
+        std::cout << N+1 << " cannot be placed\n";
+      } else {
+        std::cout << N+1 << " can go in box";
+        for (size_t i=0; i<found[m].fitsAfter.size(); i++)
+          std::cout << ' ' << found[m].fitsAfter[i];
+        std::cout << '\n';
+      }
+      if (printSolutions)
+        for (size_t i=m; i<=end; i++)
+          printMoved(boxes, found[i].x, found[i].to);
+      m = end+1;
+    }
+    std::cout << '\n' << std::flush;
+  }
+
+  // stop timer
+  long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+  std::cout << "  " << solutions << " solutions read, " << moves << " moves found, "
+            << extendable << " solutions that N+1 fits in\n";
+  std::cout << "  time is " << duration_ms << " ms\n" << std::flush;
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+  The rules of the puzzle as policies for the search in boxes.cpp, so that a variant
+    of the puzzle is a different template argument instead of an edit of step().
+
+  Each box has a row of bits like sums[box][] in boxes.cpp. When n goes in a box, the
+    numbers that n plus something in the row would make can no longer go in the box.
+    A sum rule says what the row holds and how it grows...
+    SubsetSums   Rule #1: the row is every sum of a set of numbers in the box, so n
+                 makes row + n, and the row becomes row, row + n, and n
+    PairSums     only sums of two different numbers are forbidden: the row is the
+                 numbers of the box, so n makes row + n, and the row only gets n.
+                 With Multiple<2>, which forbids x + x, this is Schur's problem of
+                 sum-free sets, whose answers for 1 to 4 boxes are the Schur
+                 numbers 1, 4, 13, 44 (see --checkSchur)
+  newSums(shifted, row) gets a word of the row shifted up by n and the same word of
+    the row, and returns the numbers in that word that n makes and that are not
+    already forbidden. add(row, newSums) is that word of the row after n was added,
+    apart from n itself, which the search adds.
+  A multiple rule gives of(n), the number that n forbids in its box, or 0 for none...
+    Multiple<k>  Rule #2 for k = 2: no number in a box is k times another
+    NoMultiple   no such rule
+  Numbers are placed in increasing order, so x only ever has to forbid k*x.
+
+  These are all inlined, so each rule set compiles to the same loops as if it were
+    written into step(). --rules picks one of the sets that boxes.cpp compiles.
+    --bound assumes the rules of the puzzle (see bounds.h), so it only works with them.
+*/
+
+#ifndef RULES_H
+#define RULES_H
+
+#include <cstdint>
+#include <cstring>
+
+
+namespace rules {
+
+
+struct SubsetSums {
+  static uint64_t newSums(uint64_t shifted, uint64_t row) { return shifted & ~row; }
+  static uint64_t add(uint64_t row, uint64_t newSums) { return row | newSums; }
+};
+
+struct PairSums {
+  static uint64_t newSums(uint64_t shifted, uint64_t) { return shifted; }
+  static uint64_t add(uint64_t row, uint64_t) { return row; }
+};
+
+
+template <int k>
+struct Multiple {
+  static int of(int n) { return k * n; }
+};
+
+struct NoMultiple {
+  static int of(int) { return 0; }
+};
+
+
+// the sets of rules that boxes.cpp is compiled for
+enum Set { puzzle, schur, triples };
+
+inline const char *name(Set set) {
+  return set == schur ? "schur" : set == triples ? "triples" : "puzzle";
+}
+
+inline bool parse(const char *text, Set &set) {
+  if (!strcmp(text, "puzzle"))
+    set = puzzle;           // SubsetSums and Multiple<2>
+  else if (!strcmp(text, "schur"))
+    set = schur;            // PairSums and Multiple<2>
+  else if (!strcmp(text, "triples"))
+    set = triples;          // SubsetSums and Multiple<3>
+  else
+    return false;
+  return true;
+}
+
+
+}  // namespace rules
+
+
+#endif
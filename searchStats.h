@@ -0,0 +1,155 @@
+/*
+  Counters of where the search tree goes, for deciding what to speed up.
+
+  Uncomment "#define STATS" in boxes.cpp or boxesCounting.cpp (before this file is
+    included) to turn them on. Each counter is only touched inside STAT(...), which
+    is empty without STATS, so the search is exactly the same as before.
+  For each depth...
+    nodes          calls of step(), or frames entered
+    children       steps one level deeper that were started from here
+                   (children/nodes is the branching factor)
+    prunes         nodes pruned by the look-ahead check
+    leaves         nodes where n could not go in any box (possibilities[n] is 0)
+    symmetrySkips  boxes not tried because an earlier empty box was already tried
+    forced         levels where --forced removed the branching (boxesCounting.cpp)
+  and, for the prunes, how far past n the number that could not be placed was.
+
+  Each thread counts into its own Counters, which are added to the total when the
+    thread ends, so --threads works too. dump() writes everything as JSON.
+*/
+
+#ifndef SEARCH_STATS_H
+#define SEARCH_STATS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+#ifdef STATS
+  #define STAT(statement) statement
+#else
+  #define STAT(statement)
+#endif
+
+
+namespace stats {
+
+
+struct Counters {
+  std::vector<uint64_t> nodes, children, prunes, leaves, symmetrySkips, forced;   // by depth
+  std::vector<uint64_t> pruneDistance;                                     // by dead - n
+
+  static void add(std::vector<uint64_t> &counter, size_t i, uint64_t amount) {
+    if (i >= counter.size())
+      counter.resize(i+1);
+    counter[i] += amount;
+  }
+
+  static void addAll(std::vector<uint64_t> &counter, const std::vector<uint64_t> &other) {
+    for (size_t i=0; i<other.size(); i++)
+      add(counter, i, other[i]);
+  }
+
+  void merge(const Counters &other) {
+    addAll(nodes, other.nodes);
+    addAll(children, other.children);
+    addAll(prunes, other.prunes);
+    addAll(leaves, other.leaves);
+    addAll(symmetrySkips, other.symmetrySkips);
+    addAll(forced, other.forced);
+    addAll(pruneDistance, other.pruneDistance);
+  }
+
+  void clear() {
+    *this = Counters();
+  }
+};
+
+
+inline std::mutex &totalMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline Counters &total() {
+  static Counters counters;
+  return counters;
+}
+
+
+// the counters of this thread, which are added to total() when the thread ends
+struct ThreadCounters : Counters {
+  ~ThreadCounters() {
+    std::lock_guard<std::mutex> lock(totalMutex());
+    total().merge(*this);
+  }
+};
+
+inline Counters &local() {
+  static thread_local ThreadCounters counters;
+  return counters;
+}
+
+
+inline void node(size_t depth)                  { Counters::add(local().nodes, depth, 1); }
+inline void child(size_t depth)                 { Counters::add(local().children, depth, 1); }
+inline void leaf(size_t depth)                  { Counters::add(local().leaves, depth, 1); }
+inline void symmetrySkip(size_t depth, int how) { Counters::add(local().symmetrySkips, depth, how); }
+inline void forced(size_t depth)                { Counters::add(local().forced, depth, 1); }
+inline void prune(size_t depth, size_t distance) {
+  Counters::add(local().prunes, depth, 1);
+  Counters::add(local().pruneDistance, distance, 1);
+}
+
+
+// Add this thread's counters to total(). Other threads must have already ended.
+inline void collect() {
+  std::lock_guard<std::mutex> lock(totalMutex());
+  total().merge(local());
+  local().clear();
+}
+
+// Start counting again, such as before the next --worker task.
+inline void reset() {
+  std::lock_guard<std::mutex> lock(totalMutex());
+  total().clear();
+  local().clear();
+}
+
+
+inline std::string list(const std::vector<uint64_t> &counter, size_t length) {
+  std::string text = "[";
+  for (size_t i=0; i<length; i++)
+    text += (i ? "," : "") + std::to_string(i < counter.size() ? counter[i] : 0);
+  return text + "]";
+}
+
+// Write total() as JSON. about is more JSON members, such as "\"boxNum\": 5", describing the run.
+inline bool dump(const std::string &file, const std::string &about) {
+  const Counters &c = total();
+  size_t depths = std::max({c.nodes.size(), c.children.size(), c.prunes.size(), c.leaves.size(), c.symmetrySkips.size(), c.forced.size()});
+  std::ofstream out(file.c_str());
+  out << "{\n";
+  if (!about.empty())
+    out << "  " << about << ",\n";
+  out << "  \"nodes\": " << list(c.nodes, depths) << ",\n";
+  out << "  \"children\": " << list(c.children, depths) << ",\n";
+  out << "  \"prunes\": " << list(c.prunes, depths) << ",\n";
+  out << "  \"leaves\": " << list(c.leaves, depths) << ",\n";
+  out << "  \"symmetrySkips\": " << list(c.symmetrySkips, depths) << ",\n";
+  out << "  \"forced\": " << list(c.forced, depths) << ",\n";
+  out << "  \"pruneDistance\": " << list(c.pruneDistance, c.pruneDistance.size()) << "\n";
+  out << "}\n";
+  out.flush();
+  return (bool)out;
+}
+
+
+}  // namespace stats
+
+
+#endif
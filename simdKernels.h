@@ -0,0 +1,360 @@
+/*
+  AVX2 and AVX-512 versions of the two hottest loops of the searches, for
+    possibilities[] arrays of uint8_t or uint16_t.
+
+    firstZero(p, from, to)  the first zero of p[from] through p[to-1], or to if none.
+                            This used to be the "prune by looking ahead" loop.
+    clearBits(p, bits, fromWord, toWord, length, bit)
+                            for each set bit k of bits[fromWord] through bits[toWord-1],
+                            remove bit from p[k], where k < length is also required.
+                            Returns the smallest such k for which p[k] is now zero, or
+                            length if none. This is the loop that removes NEWsums from
+                            possibilitiesNew[], and what it returns keeps the searches'
+                            dead numbers up to date.
+
+  For clearBits(), AVX-512 uses each 64-bit word of bits[] directly as the mask of a
+    masked load and store of 64 uint8_t or 2x32 uint16_t, so no byte past length is
+    touched. AVX2 has no such masks, so each 32 or 16 bits are expanded into a vector of
+    0x00 and 0xFF, and words that end past length are done the scalar way.
+
+  The best version for the CPU is picked once, when the program starts, so the same
+    executable still runs on CPUs without AVX2. Any other element type (such as a
+    uint32_t possType) always uses the scalar loops.
+  Needs GCC or Clang (for __attribute__((target)) and __builtin_cpu_supports).
+*/
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <immintrin.h>
+  #define SIMD_KERNELS_X86
+#endif
+
+
+namespace simd {
+
+
+// the scalar loops, which are also used for the ends of arrays
+
+template <class T>
+inline int firstZeroScalar(const T *p, int from, int to) {
+  for (int i = from; i < to; i++)
+    if (!p[i])
+      return i;
+  return to;
+}
+
+template <class T>
+inline int clearBitsScalar(T *p, const uint64_t *bits, int fromWord, int toWord, int length, T bit) {
+  T mask = ~bit;
+  int first = length;
+  for (int i = fromWord; i < toWord; i++) {
+    uint64_t temp = bits[i];
+    while (temp) {
+      int k = __builtin_ctzll(temp) + (i << 6);
+      if (k >= length)
+        return first;
+      p[k] &= mask;
+      if (!p[k] && first == length)   // k only increases, so the first is the smallest
+        first = k;
+      temp &= temp - 1;
+    }
+  }
+  return first;
+}
+
+// the bits of bits[i] that are less than length
+inline uint64_t inLength(uint64_t word, int i, int length) {
+  int left = length - (i << 6);
+  return left >= 64 ? word : word & ((((uint64_t)1) << left) - 1);   // left > 0 since word i is started
+}
+
+
+
+#ifdef SIMD_KERNELS_X86
+
+
+// AVX2
+
+__attribute__((target("avx2")))
+inline int firstZeroAVX2(const uint8_t *p, int from, int to) {
+  int i = from;
+  const __m256i zero = _mm256_setzero_si256();
+  for (; i + 32 <= to; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    uint32_t zeros = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+    if (zeros)
+      return i + __builtin_ctz(zeros);
+  }
+  return firstZeroScalar(p, i, to);
+}
+
+__attribute__((target("avx2")))
+inline int firstZeroAVX2(const uint16_t *p, int from, int to) {
+  int i = from;
+  const __m256i zero = _mm256_setzero_si256();
+  for (; i + 16 <= to; i += 16) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+    uint32_t zeros = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, zero));   // 2 bits per uint16_t
+    if (zeros)
+      return i + (__builtin_ctz(zeros) >> 1);
+  }
+  return firstZeroScalar(p, i, to);
+}
+
+// 32 bits to 32 bytes of 0x00 or 0xFF
+__attribute__((target("avx2")))
+inline __m256i expandBytes(uint32_t bits) {
+  const __m256i spread = _mm256_setr_epi8(0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1,
+                                          2,2,2,2,2,2,2,2, 3,3,3,3,3,3,3,3);
+  const __m256i select = _mm256_set1_epi64x((long long)0x8040201008040201ULL);
+  __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32((int)bits), spread);
+  return _mm256_cmpeq_epi8(_mm256_and_si256(v, select), select);
+}
+
+// 16 bits to 16 uint16_t of 0x0000 or 0xFFFF
+__attribute__((target("avx2")))
+inline __m256i expandWords(uint32_t bits) {
+  const __m256i select = _mm256_setr_epi16(1, 2, 4, 8, 16, 32, 64, 128,
+                                           256, 512, 1024, 2048, 4096, 8192, 16384, (short)32768);
+  __m256i v = _mm256_set1_epi16((short)bits);
+  return _mm256_cmpeq_epi16(_mm256_and_si256(v, select), select);
+}
+
+// the smaller of first and the scalar way for the last word
+template <class T>
+inline int clearBitsTail(T *p, const uint64_t *bits, int i, int toWord, int length, T bit, int first) {
+  int tail = clearBitsScalar(p, bits, i, toWord, length, bit);
+  return first < tail ? first : tail;
+}
+
+__attribute__((target("avx2")))
+inline int clearBitsAVX2(uint8_t *p, const uint64_t *bits, int fromWord, int toWord, int length, uint8_t bit) {
+  const __m256i b = _mm256_set1_epi8((char)bit);
+  const __m256i zero = _mm256_setzero_si256();
+  int first = length;
+  for (int i = fromWord; i < toWord; i++) {
+    uint64_t word = bits[i];
+    if (!word)
+      continue;
+    if ((i << 6) + 64 > length)   // the last word is done the scalar way
+      return clearBitsTail(p, bits, i, toWord, length, bit, first);
+    for (int half = 0; half < 2; half++) {
+      uint32_t m = (uint32_t)(word >> (32 * half));
+      if (!m)
+        continue;
+      __m256i *q = (__m256i *)(p + (i << 6) + 32 * half);
+      __m256i v = _mm256_andnot_si256(_mm256_and_si256(expandBytes(m), b), _mm256_loadu_si256(q));
+      _mm256_storeu_si256(q, v);
+      uint32_t zeros = m & (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero));
+      if (zeros && first == length)
+        first = (i << 6) + 32 * half + __builtin_ctz(zeros);
+    }
+  }
+  return first;
+}
+
+__attribute__((target("avx2")))
+inline int clearBitsAVX2(uint16_t *p, const uint64_t *bits, int fromWord, int toWord, int length, uint16_t bit) {
+  const __m256i b = _mm256_set1_epi16((short)bit);
+  const __m256i zero = _mm256_setzero_si256();
+  int first = length;
+  for (int i = fromWord; i < toWord; i++) {
+    uint64_t word = bits[i];
+    if (!word)
+      continue;
+    if ((i << 6) + 64 > length)
+      return clearBitsTail(p, bits, i, toWord, length, bit, first);
+    for (int quarter = 0; quarter < 4; quarter++) {
+      uint32_t m = (uint32_t)(word >> (16 * quarter)) & 0xFFFF;
+      if (!m)
+        continue;
+      __m256i *q = (__m256i *)(p + (i << 6) + 16 * quarter);
+      __m256i v = _mm256_andnot_si256(_mm256_and_si256(expandWords(m), b), _mm256_loadu_si256(q));
+      _mm256_storeu_si256(q, v);
+      if (first == length) {
+        uint32_t zeros = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi16(v, zero));   // 2 bits per uint16_t
+        for (uint32_t temp = m; temp; temp &= temp - 1)
+          if ((zeros >> (2 * __builtin_ctz(temp))) & 1) {
+            first = (i << 6) + 16 * quarter + __builtin_ctz(temp);
+            break;
+          }
+      }
+    }
+  }
+  return first;
+}
+
+
+// AVX-512 (BW is needed for 8-bit and 16-bit elements)
+
+__attribute__((target("avx512f,avx512bw")))
+inline int firstZeroAVX512(const uint8_t *p, int from, int to) {
+  for (int i = from; i < to; i += 64) {
+    __mmask64 inside = to - i >= 64 ? ~(__mmask64)0 : (((__mmask64)1) << (to - i)) - 1;
+    __m512i v = _mm512_maskz_loadu_epi8(inside, p + i);
+    uint64_t zeros = inside & ~_mm512_test_epi8_mask(v, v);
+    if (zeros)
+      return i + __builtin_ctzll(zeros);
+  }
+  return to;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline int firstZeroAVX512(const uint16_t *p, int from, int to) {
+  for (int i = from; i < to; i += 32) {
+    __mmask32 inside = to - i >= 32 ? ~(__mmask32)0 : (((__mmask32)1) << (to - i)) - 1;
+    __m512i v = _mm512_maskz_loadu_epi16(inside, p + i);
+    uint32_t zeros = inside & ~_mm512_test_epi16_mask(v, v);
+    if (zeros)
+      return i + __builtin_ctz(zeros);
+  }
+  return to;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline int clearBitsAVX512(uint8_t *p, const uint64_t *bits, int fromWord, int toWord, int length, uint8_t bit) {
+  const __m512i mask = _mm512_set1_epi8((char)~bit);
+  int first = length;
+  for (int i = fromWord; i < toWord; i++) {
+    uint64_t word = bits[i];
+    if (!word)
+      continue;
+    word = inLength(word, i, length);
+    uint8_t *q = p + (i << 6);
+    __m512i v = _mm512_and_si512(_mm512_maskz_loadu_epi8(word, q), mask);
+    _mm512_mask_storeu_epi8(q, word, v);
+    uint64_t zeros = word & ~_mm512_test_epi8_mask(v, v);
+    if (zeros && first == length)
+      first = (i << 6) + __builtin_ctzll(zeros);
+  }
+  return first;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline int clearBitsAVX512(uint16_t *p, const uint64_t *bits, int fromWord, int toWord, int length, uint16_t bit) {
+  const __m512i mask = _mm512_set1_epi16((short)(uint16_t)~bit);
+  int first = length;
+  for (int i = fromWord; i < toWord; i++) {
+    uint64_t word = bits[i];
+    if (!word)
+      continue;
+    word = inLength(word, i, length);
+    uint16_t *q = p + (i << 6);
+    __mmask32 low = (__mmask32)word;
+    __mmask32 high = (__mmask32)(word >> 32);
+    uint64_t zeros = 0;
+    if (low) {
+      __m512i v = _mm512_and_si512(_mm512_maskz_loadu_epi16(low, q), mask);
+      _mm512_mask_storeu_epi16(q, low, v);
+      zeros |= low & ~_mm512_test_epi16_mask(v, v);
+    }
+    if (high) {
+      __m512i v = _mm512_and_si512(_mm512_maskz_loadu_epi16(high, q + 32), mask);
+      _mm512_mask_storeu_epi16(q + 32, high, v);
+      zeros |= (uint64_t)(high & ~_mm512_test_epi16_mask(v, v)) << 32;
+    }
+    if (zeros && first == length)
+      first = (i << 6) + __builtin_ctzll(zeros);
+  }
+  return first;
+}
+
+
+#endif  // SIMD_KERNELS_X86
+
+
+
+/*
+  Picking a version.
+  Kernels<T>::firstZero and Kernels<T>::clearBits point to the best version for this
+    CPU, and are set before main() starts.
+*/
+
+enum Level { scalarLevel, avx2Level, avx512Level };
+
+inline Level cpuLevel() {
+#ifdef SIMD_KERNELS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    return avx512Level;
+  if (__builtin_cpu_supports("avx2"))
+    return avx2Level;
+#endif
+  return scalarLevel;
+}
+
+inline const char *levelName(Level level) {
+  return level == avx512Level ? "AVX-512" : level == avx2Level ? "AVX2" : "scalar";
+}
+
+// the level of --simd scalar, avx2, or avx512
+inline bool parseLevel(const char *text, Level &level) {
+  if (!strcmp(text, "scalar"))
+    level = scalarLevel;
+  else if (!strcmp(text, "avx2"))
+    level = avx2Level;
+  else if (!strcmp(text, "avx512"))
+    level = avx512Level;
+  else
+    return false;
+  return true;
+}
+
+
+template <class T>
+struct Kernels {
+  typedef int (*FirstZero)(const T *, int, int);
+  typedef int (*ClearBits)(T *, const uint64_t *, int, int, int, T);
+  static FirstZero firstZero;
+  static ClearBits clearBits;
+  static Level level;
+  static void use(Level l) {   // only scalar for types other than uint8_t and uint16_t
+    (void)l;
+    level = scalarLevel;
+    firstZero = &firstZeroScalar<T>;
+    clearBits = &clearBitsScalar<T>;
+  }
+  static FirstZero pickFirstZero() { use(cpuLevel()); return firstZero; }
+};
+
+#ifdef SIMD_KERNELS_X86
+template <>
+inline void Kernels<uint8_t>::use(Level l) {
+  level = l;
+  firstZero = l == avx512Level ? (FirstZero)&firstZeroAVX512 : l == avx2Level ? (FirstZero)&firstZeroAVX2 : &firstZeroScalar<uint8_t>;
+  clearBits = l == avx512Level ? (ClearBits)&clearBitsAVX512 : l == avx2Level ? (ClearBits)&clearBitsAVX2 : &clearBitsScalar<uint8_t>;
+}
+
+template <>
+inline void Kernels<uint16_t>::use(Level l) {
+  level = l;
+  firstZero = l == avx512Level ? (FirstZero)&firstZeroAVX512 : l == avx2Level ? (FirstZero)&firstZeroAVX2 : &firstZeroScalar<uint16_t>;
+  clearBits = l == avx512Level ? (ClearBits)&clearBitsAVX512 : l == avx2Level ? (ClearBits)&clearBitsAVX2 : &clearBitsScalar<uint16_t>;
+}
+#endif
+
+template <class T> Level Kernels<T>::level = scalarLevel;
+template <class T> typename Kernels<T>::ClearBits Kernels<T>::clearBits = &clearBitsScalar<T>;
+template <class T> typename Kernels<T>::FirstZero Kernels<T>::firstZero = Kernels<T>::pickFirstZero();   // also sets clearBits and level
+
+
+template <class T>
+inline int firstZero(const T *p, int from, int to) {
+  return Kernels<T>::firstZero(p, from, to);
+}
+
+template <class T>
+inline int clearBits(T *p, const uint64_t *bits, int fromWord, int toWord, int length, T bit) {
+  return Kernels<T>::clearBits(p, bits, fromWord, toWord, length, bit);
+}
+
+
+}  // namespace simd
+
+
+#endif
@@ -0,0 +1,347 @@
+/*
+  Writing solutions as a compact stream of records instead of printing them, for
+    --solutions, and reading them back, for verify.cpp.
+
+  A solution of 1 through max in boxNum boxes is stored as its runs, where a run is a
+    box and the first and last of some consecutive numbers that are all in that box.
+    The runs go in order, so together they are 1, 2, ..., max. A counting box of
+    thousands of numbers is then a single run, and a solution from boxes.cpp is about
+    one run per number.
+  The format is picked by the end of the file name...
+    .jsonl   one line of JSON per solution, like
+             {"max": 8, "boxes": 3, "runs": [[0,1,1],[1,2,2],[0,3,3],[2,4,4],[1,5,6],[0,7,7],[2,8,8]]}
+             where each run is [box, first, last]
+    .bin     "BOXS" then, for each solution, max, boxNum, the number of runs, and each
+             run's box and length, all as LEB128 varints (7 bits per byte)
+  and either can end in .gz to be gzip compressed, which needs zlib...
+    g++ -O3 -std=c++11 -DUSE_ZLIB boxesCounting.cpp -lz
+  Records are kept in a buffer and written when it is big or every flushSeconds, so
+    a run that prints millions of solutions ("ALL best solutions") is not slowed down
+    by writing each one. Call flush() before relying on the file (the searches do at
+    the end), since a crash loses what is still in the buffer.
+*/
+
+#ifndef SOLUTION_STREAM_H
+#define SOLUTION_STREAM_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef USE_ZLIB
+  #include <zlib.h>
+#endif
+
+
+namespace solutionStream {
+
+
+struct Run {
+  int box;
+  uint32_t first, last;
+};
+
+const size_t bufferBytes = 1 << 20;   // write the buffer once it is this big,
+const int flushSeconds = 10;          // or once this long has passed since the last write
+
+
+inline bool endsWith(const std::string &text, const std::string &end) {
+  return text.size() >= end.size() && text.compare(text.size() - end.size(), end.size(), end) == 0;
+}
+
+
+// a file that may be gzip compressed
+class File {
+public:
+  File() : plain(nullptr)
+#ifdef USE_ZLIB
+    , compressed(nullptr)
+#endif
+  {}
+  ~File() { close(); }
+
+  // mode is "rb" or "wb". Reading with zlib also reads files that are not compressed.
+  bool open(const std::string &name, const char *mode) {
+    close();
+#ifdef USE_ZLIB
+    if (mode[0] == 'r' || endsWith(name, ".gz")) {
+      compressed = gzopen(name.c_str(), mode);
+      return compressed != nullptr;
+    }
+#else
+    if (endsWith(name, ".gz"))
+      return false;
+#endif
+    plain = fopen(name.c_str(), mode);
+    return plain != nullptr;
+  }
+
+  bool write(const char *data, size_t length) {
+#ifdef USE_ZLIB
+    if (compressed)
+      return length == 0 || gzwrite(compressed, data, (unsigned)length) == (int)length;
+#endif
+    return plain && fwrite(data, 1, length, plain) == length;
+  }
+
+  size_t read(char *data, size_t length) {
+#ifdef USE_ZLIB
+    if (compressed) {
+      int got = gzread(compressed, data, (unsigned)length);
+      return got > 0 ? got : 0;
+    }
+#endif
+    return plain ? fread(data, 1, length, plain) : 0;
+  }
+
+  void flush() {
+#ifdef USE_ZLIB
+    if (compressed)
+      gzflush(compressed, Z_SYNC_FLUSH);
+#endif
+    if (plain)
+      fflush(plain);
+  }
+
+  void close() {
+#ifdef USE_ZLIB
+    if (compressed)
+      gzclose(compressed);
+    compressed = nullptr;
+#endif
+    if (plain)
+      fclose(plain);
+    plain = nullptr;
+  }
+
+private:
+  FILE *plain;
+#ifdef USE_ZLIB
+  gzFile compressed;
+#endif
+};
+
+
+inline void putVarint(std::string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += (char)((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += (char)value;
+}
+
+
+
+class Writer {
+public:
+  Writer() : binary(false), isOpen(false) {}
+  ~Writer() { close(); }
+
+  // Returns false if the file cannot be written (or is .gz without zlib).
+  bool open(const std::string &name) {
+    close();
+    binary = endsWith(name, ".bin") || endsWith(name, ".bin.gz");
+    if (!file.open(name, "wb"))
+      return false;
+    isOpen = true;
+    lastFlush = std::chrono::steady_clock::now();
+    if (binary)
+      buffer = "BOXS";
+    return true;
+  }
+
+  bool opened() const { return isOpen; }
+
+  void write(uint32_t max, int boxNum, const std::vector<Run> &runs) {
+    if (binary) {
+      putVarint(buffer, max);
+      putVarint(buffer, boxNum);
+      putVarint(buffer, runs.size());
+      for (size_t i=0; i<runs.size(); i++) {
+        putVarint(buffer, runs[i].box);
+        putVarint(buffer, runs[i].last - runs[i].first + 1);
+      }
+    } else {
+      buffer += "{\"max\": " + std::to_string(max) + ", \"boxes\": " + std::to_string(boxNum) + ", \"runs\": [";
+      for (size_t i=0; i<runs.size(); i++)
+        buffer += (i ? ",[" : "[") + std::to_string(runs[i].box) + "," + std::to_string(runs[i].first)
+                  + "," + std::to_string(runs[i].last) + "]";
+      buffer += "]}\n";
+    }
+    if (buffer.size() > bufferBytes
+        || std::chrono::steady_clock::now() - lastFlush > std::chrono::seconds(flushSeconds))
+      flush();
+  }
+
+  void flush() {
+    if (!isOpen)
+      return;
+    file.write(buffer.data(), buffer.size());
+    file.flush();
+    buffer.clear();
+    lastFlush = std::chrono::steady_clock::now();
+  }
+
+  void close() {
+    if (!isOpen)
+      return;
+    flush();
+    file.close();
+    isOpen = false;
+  }
+
+private:
+  File file;
+  bool binary;
+  bool isOpen;
+  std::string buffer;
+  std::chrono::steady_clock::time_point lastFlush;
+};
+
+
+
+class Reader {
+public:
+  Reader() : start(0), end(0), binary(false), done(false) {}
+
+  // Returns false if the file cannot be read or is in neither format.
+  bool open(const std::string &name) {
+    if (!file.open(name, "rb"))
+      return false;
+    start = end = 0;
+    done = false;
+    if (!fill(4))
+      return false;
+    binary = !memcmp(data.data() + start, "BOXS", 4);
+    if (binary)
+      start += 4;
+    else if (data[start] != '{')
+      return false;
+    return true;
+  }
+
+  // Read the next solution. Returns false at the end of the file or if the record is
+  //   cut short, and sets broken in the second case.
+  bool next(uint32_t &max, int &boxNum, std::vector<Run> &runs, bool &broken) {
+    runs.clear();
+    broken = false;
+    if (binary) {
+      uint64_t count, value;
+      if (!fill(1))
+        return false;
+      broken = true;
+      if (!getVarint(value))
+        return false;
+      max = (uint32_t)value;
+      if (!getVarint(value) || !getVarint(count))
+        return false;
+      boxNum = (int)value;
+      uint32_t first = 1;
+      for (uint64_t i=0; i<count; i++) {
+        uint64_t box, length;
+        if (!getVarint(box) || !getVarint(length) || length == 0)
+          return false;
+        Run run = {(int)box, first, (uint32_t)(first + length - 1)};
+        runs.push_back(run);
+        first += length;
+      }
+      broken = false;
+      return true;
+    }
+
+    // one line of JSON, read as the numbers after "max", "boxes", and "runs"
+    std::string line;
+    if (!getLine(line))
+      return false;
+    broken = true;
+    size_t at = line.find("\"max\"");
+    size_t atBoxes = line.find("\"boxes\"");
+    size_t atRuns = line.find("\"runs\"");
+    if (at == std::string::npos || atBoxes == std::string::npos || atRuns == std::string::npos)
+      return false;
+    max = strtoul(line.c_str() + line.find(':', at) + 1, nullptr, 10);
+    boxNum = atoi(line.c_str() + line.find(':', atBoxes) + 1);
+    std::vector<uint32_t> numbers;
+    for (size_t i = atRuns + 6; i < line.size(); ) {
+      if (line[i] >= '0' && line[i] <= '9') {
+        char *after;
+        numbers.push_back(strtoul(line.c_str() + i, &after, 10));
+        i = after - line.c_str();
+      } else {
+        i++;
+      }
+    }
+    if (numbers.size() % 3)
+      return false;
+    for (size_t i=0; i<numbers.size(); i+=3) {
+      Run run = {(int)numbers[i], numbers[i+1], numbers[i+2]};
+      runs.push_back(run);
+    }
+    broken = false;
+    return true;
+  }
+
+private:
+  // have at least count bytes from start
+  bool fill(size_t count) {
+    while (end - start < count && !done) {
+      if (start > 0) {
+        data.erase(0, start);
+        end -= start;
+        start = 0;
+      }
+      data.resize(end + (1 << 16));
+      size_t got = file.read(&data[end], 1 << 16);
+      if (got == 0)
+        done = true;
+      end += got;
+      data.resize(end);
+    }
+    return end - start >= count;
+  }
+
+  bool getVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      if (!fill(1))
+        return false;
+      unsigned char byte = data[start++];
+      value |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool getLine(std::string &line) {
+    line.clear();
+    while (true) {
+      if (!fill(1))
+        return !line.empty();
+      size_t newline = data.find('\n', start);
+      if (newline != std::string::npos && newline < end) {
+        line.append(data, start, newline - start);
+        start = newline + 1;
+        return true;
+      }
+      line.append(data, start, end - start);
+      start = end;
+    }
+  }
+
+  File file;
+  std::string data;   // data[start..end) is read but not used yet
+  size_t start, end;
+  bool binary;
+  bool done;
+};
+
+
+}  // namespace solutionStream
+
+
+#endif
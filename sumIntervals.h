@@ -0,0 +1,163 @@
+/*
+  The sums of a counting box as a sorted list of intervals, for boxesCounting.cpp.
+
+  A counting box is mostly long runs of consecutive numbers, and so are its sums. After
+    its first interval [n, 2n-1], the sums are n through firstAllowed + n except for 2n
+    and firstAllowed, plus firstAllowed + 2n, which is 4 intervals, while a row of
+    sums[] is sumsLength words (3073 for 16 boxes) that every step into the box copied
+    and then went through word by word for each number of the interval it added.
+  As intervals, adding x to the box (the sums become sums, sums + x, and x) is one merge
+    of the list with itself shifted by x, and the sums that are new are found the same
+    way, so a step costs about the number of intervals instead of sumsLength. Only the
+    numbers up to limit (maxSteps) are kept.
+  Boxes that get one number at a time keep their rows, since their sums have many
+    gaps. toRow() turns a list into a row for the code that needs one (see --bound).
+*/
+
+#ifndef SUM_INTERVALS_H
+#define SUM_INTERVALS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+
+namespace sumIntervals {
+
+
+struct Interval {
+  uint32_t first, last;   // the sums first through last
+};
+
+typedef std::vector<Interval> List;   // sorted, with no two intervals touching
+
+
+// add [first, last] to the end of list, where first is not before the start of the last interval
+inline void add(List &list, uint32_t first, uint32_t last) {
+  if (!list.empty() && first <= list.back().last + 1) {
+    if (last > list.back().last)
+      list.back().last = last;
+  } else {
+    Interval in = {first, last};
+    list.push_back(in);
+  }
+}
+
+// the same, but only the part up to limit
+inline void add(List &list, uint32_t first, uint32_t last, uint32_t limit) {
+  if (first > limit)
+    return;
+  add(list, first, last < limit ? last : limit);
+}
+
+
+// sumsNew is the sums after first through last are added to a box with sums
+// Adding x makes the sums sums, sums + x, and x, which, with 0 counted as a sum, is
+//   sums + {0, x}. So adding the whole run makes them sums + runSums, with 0 in both,
+//   where runSums, the sums of sets of the run, are the intervals from the sum of the
+//   j smallest to the sum of the j largest for each j. These overlap except for a few j
+//   near each end, so sumsNew is a few shifted copies of sums, and the cost does not
+//   grow with the length of the run, unlike adding one number at a time.
+inline void addRun(const List &sums, uint32_t first, uint32_t last, uint32_t limit, List &sumsNew) {
+  static thread_local List runSums;
+  runSums.clear();
+  uint64_t length = last - first + 1;
+  for (uint64_t j=0; j<=length; j++) {
+    uint64_t smallest = j*first + j*(j-1)/2;
+    if (smallest > limit)
+      break;
+    uint64_t largest = smallest + j*(length-j);
+    add(runSums, (uint32_t)smallest, (uint32_t)(largest < limit ? largest : limit));
+  }
+
+  // each interval of sums (and 0) plus each interval of runSums, then sorted and joined
+  sumsNew.clear();
+  for (size_t i=0; i<=sums.size(); i++) {
+    Interval from = {0, 0};
+    if (i)
+      from = sums[i-1];
+    for (size_t j=0; j<runSums.size() && from.first + runSums[j].first <= limit; j++) {
+      uint32_t end = from.last + runSums[j].last;
+      Interval in = {from.first + runSums[j].first, end < limit ? end : limit};
+      sumsNew.push_back(in);
+    }
+  }
+  std::sort(sumsNew.begin(), sumsNew.end(), [](const Interval &a, const Interval &b) {
+    return a.first < b.first;
+  });
+  size_t joined = 0;
+  for (size_t i=0; i<sumsNew.size(); i++) {
+    if (joined && sumsNew[i].first <= sumsNew[joined-1].last + 1) {
+      if (sumsNew[i].last > sumsNew[joined-1].last)
+        sumsNew[joined-1].last = sumsNew[i].last;
+    } else {
+      sumsNew[joined++] = sumsNew[i];
+    }
+  }
+  sumsNew.resize(joined);
+
+  // 0 is not a sum
+  if (sumsNew[0].last == 0)
+    sumsNew.erase(sumsNew.begin());
+  else
+    sumsNew[0].first = 1;
+}
+
+
+// call each(first, last) for every interval of the sums from "from" onwards that are in
+//   sumsNew but not in sums, where sums only has sums that are in sumsNew
+template <class Each>
+void forEachNew(const List &sumsNew, const List &sums, uint32_t from, Each each) {
+  size_t j = 0;
+  for (size_t i=0; i<sumsNew.size(); i++) {
+    uint32_t first = sumsNew[i].first > from ? sumsNew[i].first : from;
+    uint32_t last = sumsNew[i].last;
+    if (first > last)
+      continue;
+    while (j < sums.size() && sums[j].last < first)
+      j++;
+    for (size_t k = j; ; k++) {
+      if (k == sums.size() || sums[k].first > last) {
+        each(first, last);
+        break;
+      }
+      if (sums[k].first > first)
+        each(first, sums[k].first - 1);
+      if (sums[k].last >= last)
+        break;
+      first = sums[k].last + 1;
+    }
+  }
+}
+
+
+// set bits first through last of row
+inline void setRange(uint64_t *row, uint32_t first, uint32_t last) {
+  uint32_t firstWord = first >> 6;
+  uint32_t lastWord = last >> 6;
+  uint64_t low = ~((uint64_t)0) << (first & 63);         // first onwards
+  uint64_t high = ~((uint64_t)0) >> (63 - (last & 63));  // through last
+  if (firstWord == lastWord) {
+    row[firstWord] |= low & high;
+    return;
+  }
+  row[firstWord] |= low;
+  for (uint32_t i = firstWord+1; i < lastWord; i++)
+    row[i] = ~((uint64_t)0);
+  row[lastWord] |= high;
+}
+
+// the first words words of a row of sums, like sums[box][] in boxes.cpp
+inline void toRow(const List &sums, uint64_t *row, uint32_t words) {
+  for (uint32_t i=0; i<words; i++)
+    row[i] = 0;
+  uint32_t end = words << 6;
+  for (size_t i=0; i<sums.size() && sums[i].first < end; i++)
+    setRange(row, sums[i].first, sums[i].last < end ? sums[i].last : end - 1);
+}
+
+
+}  // namespace sumIntervals
+
+
+#endif
@@ -0,0 +1,207 @@
+/*
+  A transposition table, for --table: remembering states whose subtree has already
+    been searched, so that reaching an equivalent state again by a different order of
+    placements can skip it.
+
+  What is left to search from n depends only on the possibilities of n onwards and on
+    the sums of each box, and renaming boxes changes nothing. Only the numbers below
+    end = best+2 matter, where best is best when the state is first reached...
+   - if no number below end was ever placed past, no new best was found, and
+   - adding x >= n to a box adds sums of at least x plus an old sum, so an old sum s
+     can only remove a possibility below end if s < end - n.
+  So the key is a hash of n, end, and, for each box, the bits of its sums below end - n
+    and of its possibilities from n to end, where the boxes are sorted by their hashes
+    so that it is the same for every renaming of the boxes. The numbers already placed
+    are not in the key, so two states whose boxes differ only in numbers that can no
+    longer matter get the same key, which happens mostly near the leaves, where
+    end - n is small.
+  A subtree is only stored if best did not change while it was searched. Then nothing
+    below the state got past best, and, since the key has end in it, a state with the
+    same key is only found while best is still that same number, so it can be skipped.
+    This means that equal solutions reached in a different way are skipped too, so do
+    not use it to print ALL best solutions.
+
+  The table has a fixed number of entries (--table MB), each of 16 bytes, and a key goes
+    in the entry picked by its low bits. --replace picks what happens when that entry
+    is taken...
+    always   the newest subtree replaces it
+    bigger   the subtree with more nodes is kept (log2 of the nodes is stored), so the
+             subtrees that save the most are not pushed out by the many small ones
+  Threads share the table without locks. Each entry is two atomics, with the key
+    stored XORed with the data, so an entry half written by another thread just does
+    not match (Hyatt and Mann's lockless hashing).
+*/
+
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+
+namespace transposition {
+
+
+// splitmix64's finalizer
+inline uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// the hash h continued with bits [from, to) of row
+inline uint64_t hashBits(const uint64_t *row, uint32_t from, uint32_t to, uint64_t h) {
+  if (from >= to)
+    return h;
+  uint32_t first = from >> 6, last = (to - 1) >> 6;
+  for (uint32_t i = first; i <= last; i++) {
+    uint64_t word = row[i];
+    if (i == first)
+      word &= ~((uint64_t)0) << (from & 63);
+    if (i == last)
+      word &= ~((uint64_t)0) >> (63 - ((to - 1) & 63));
+    h = mix(h ^ word) + i;
+  }
+  return h;
+}
+
+// For possibilities[] with a bit for each box, h[box] is hashBits() of the bits of box
+//   in [from, to), as if the bits of each box were a row.
+template <class possType>
+void hashPlanes(const possType *possibilities, uint32_t from, uint32_t to, int boxes, uint64_t h[]) {
+  for (int box=0; box<boxes; box++)
+    h[box] = 0;
+  if (from >= to)
+    return;
+  uint64_t word[8 * sizeof(possType)];
+  for (uint32_t i = from >> 6; i <= (to - 1) >> 6; i++) {
+    for (int box=0; box<boxes; box++)
+      word[box] = 0;
+    uint32_t start = std::max(from, i << 6), stop = std::min(to, (i + 1) << 6);
+    for (uint32_t m = start; m < stop; m++) {
+      possType x = possibilities[m];
+      while (x) {
+        word[__builtin_ctz(x)] |= (uint64_t)1 << (m & 63);
+        x &= x - 1;
+      }
+    }
+    for (int box=0; box<boxes; box++)
+      h[box] = mix(h[box] ^ word[box]) + i;
+  }
+}
+
+// one hash of the hashes of the boxes, the same in any order (sorts boxHashes)
+inline uint64_t combine(uint64_t boxHashes[], int count, uint64_t h) {
+  std::sort(boxHashes, boxHashes + count);
+  for (int i=0; i<count; i++)
+    h = mix(h ^ boxHashes[i]);
+  return h | 1;   // 0 is an empty entry
+}
+
+
+
+enum Policy { always, bigger };
+
+class Table {
+public:
+  Table() : size(0), policy(bigger), lookups(0), hits(0), stores(0) {}
+
+  // Returns false if there is not that much memory. 0 MB turns it off.
+  bool resize(size_t megabytes) {
+    size = 0;
+    entries.reset();
+    if (!megabytes)
+      return true;
+    size_t count = 1;
+    while (count * 2 * sizeof(Entry) <= megabytes << 20)
+      count *= 2;
+    entries.reset(new (std::nothrow) Entry[count]);
+    if (!entries)
+      return false;
+    for (size_t i=0; i<count; i++) {
+      entries[i].check.store(0, std::memory_order_relaxed);
+      entries[i].data.store(0, std::memory_order_relaxed);
+    }
+    size = count;
+    return true;
+  }
+
+  bool enabled() const { return size != 0; }
+
+  void setPolicy(Policy p) { policy = p; }
+
+  // Returns true if key was stored, and sets best to what best was then.
+  bool find(uint64_t key, uint32_t &best) {
+    lookups.fetch_add(1, std::memory_order_relaxed);
+    const Entry &e = entries[key & (size - 1)];
+    uint64_t data = e.data.load(std::memory_order_relaxed);
+    if ((e.check.load(std::memory_order_relaxed) ^ data) != key)
+      return false;
+    best = (uint32_t)data;
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Store that the subtree of key, of nodes nodes, did not get past best.
+  void store(uint64_t key, uint32_t best, uint64_t nodes) {
+    Entry &e = entries[key & (size - 1)];
+    uint64_t work = 64 - __builtin_clzll(nodes | 1);   // log2 of nodes, plus 1
+    if (policy == bigger) {
+      uint64_t old = e.data.load(std::memory_order_relaxed);
+      if ((old >> 32) > work)
+        return;
+    }
+    uint64_t data = (work << 32) | best;
+    e.data.store(data, std::memory_order_relaxed);
+    e.check.store(key ^ data, std::memory_order_relaxed);
+    stores.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void report() const {
+    if (!enabled())
+      return;
+    std::cout << "  table: " << lookups.load() << " lookups, " << hits.load() << " hits, "
+              << stores.load() << " stores in " << size << " entries\n" << std::flush;
+  }
+
+  void resetCounts() {
+    lookups = 0;
+    hits = 0;
+    stores = 0;
+  }
+
+private:
+  struct Entry {
+    std::atomic<uint64_t> check;   // key ^ data
+    std::atomic<uint64_t> data;    // best in the low 32 bits, log2 of the nodes above
+  };
+  std::unique_ptr<Entry[]> entries;
+  size_t size;
+  Policy policy;
+  std::atomic<uint64_t> lookups, hits, stores;
+};
+
+
+inline bool parsePolicy(const char *text, Policy &policy) {
+  if (!strcmp(text, "always"))
+    policy = always;
+  else if (!strcmp(text, "bigger"))
+    policy = bigger;
+  else
+    return false;
+  return true;
+}
+
+
+}  // namespace transposition
+
+
+#endif
@@ -0,0 +1,158 @@
+/*
+  Check solutions written with --solutions by boxes.cpp or boxesCounting.cpp, without
+    trusting the search that found them.
+
+  To compile and run...
+    g++ -O3 -std=c++11 verify.cpp -o verify
+    ./verify solutions.jsonl more.bin
+  or, to also read .gz files,
+    g++ -O3 -std=c++11 -DUSE_ZLIB verify.cpp -o verify -lz
+  See solutionStream.h for the formats. The format of each file is found from what
+    is in it, not from its name.
+
+  For each solution, it checks that the runs are 1, 2, ..., max in order, that each box
+    is less than boxNum, and that each box obeys...
+   - Rule #1: no number in a box is the sum of a set of other numbers in the box
+   - Rule #2: no number in a box is double another number in the box
+  Each box's numbers are added in increasing order to a bitset of the sums of the
+    numbers so far, like sums[box][] in boxes.cpp, so Rule #1 is one bit test per number
+    and adding a number is one shifted OR of the bitset, up to the box's total so far.
+    The 62 solutions of the 14-box run in boxesCounting.cpp (up to 43733) take about
+    a second.
+  Each solution is printed as valid, or with the first problem found. The exit code is
+    1 if any solution was not valid, so scripts can use it.
+*/
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include "solutionStream.h"
+
+
+typedef std::vector<uint64_t> Bits;   // bit i is the number i
+
+
+
+inline bool has(const Bits &bits, uint32_t i) {
+  return (i >> 6) < bits.size() && ((bits[i >> 6] >> (i & 63)) & 1);
+}
+
+inline void setBit(Bits &bits, uint32_t i) {
+  if ((i >> 6) < bits.size())
+    bits[i >> 6] |= ((uint64_t)1 << (i & 63));
+}
+
+// bits |= bits << shift for the first length words, going from the top down so that
+//   it can be done in place
+inline void orShiftedUp(Bits &bits, int length, uint32_t shift) {
+  int sdiv = shift >> 6;
+  int smod = shift & 63;
+  for (int i = length-1; i >= sdiv; i--) {
+    uint64_t word = bits[i - sdiv] << smod;
+    if (smod && i - sdiv - 1 >= 0)   // smod=0 needs to be handled separately because of the undefined right bitshift
+      word |= bits[i - sdiv - 1] >> (64 - smod);
+    bits[i] |= word;
+  }
+}
+
+
+
+// Returns an empty string if the solution is valid, or else what is wrong with it.
+std::string check(uint32_t max, int boxNum, const std::vector<solutionStream::Run> &runs) {
+
+  if (boxNum < 1)
+    return "there are no boxes";
+
+  // runs are 1, 2, ..., max
+  uint32_t next = 1;
+  for (size_t i=0; i<runs.size(); i++) {
+    const solutionStream::Run &run = runs[i];
+    if (run.first != next || run.last < run.first)
+      return "the runs do not go 1, 2, 3, ... (at " + std::to_string(next) + ")";
+    if (run.box < 0 || run.box >= boxNum)
+      return "box " + std::to_string(run.box) + " does not exist";
+    next = run.last + 1;
+  }
+  if (next != max + 1)
+    return "the runs end at " + std::to_string(next - 1) + " instead of " + std::to_string(max);
+
+  // the rules, adding the numbers of each box in increasing order
+  size_t words = (max >> 6) + 1;
+  std::vector<Bits> sums(boxNum, Bits(words, 0));       // sums of sets of the numbers so far
+  std::vector<Bits> elements(boxNum, Bits(words, 0));   // the numbers so far
+  std::vector<uint64_t> total(boxNum, 0);               // the biggest sum so far
+  for (size_t i=0; i<runs.size(); i++) {
+    int box = runs[i].box;
+    for (uint32_t x = runs[i].first; x <= runs[i].last; x++) {
+      if (has(sums[box], x))
+        return std::to_string(x) + " in box " + std::to_string(box) + " is a sum of other numbers in the box (Rule #1)";
+      if (x % 2 == 0 && has(elements[box], x/2))
+        return std::to_string(x) + " in box " + std::to_string(box) + " is double " + std::to_string(x/2) + " (Rule #2)";
+      total[box] += x;   // no sum is bigger, so the words above it are still 0
+      orShiftedUp(sums[box], std::min<uint64_t>(words, (total[box] >> 6) + 1), x);
+      setBit(sums[box], x);
+      setBit(elements[box], x);
+    }
+  }
+  return "";
+}
+
+
+
+int main(int argc, char* argv[]) {
+
+  if (argc < 2) {
+    std::cout << "bad user! bad! Give the files of solutions to check.\n" << std::flush;
+    return 1;
+  }
+
+  // start timer
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+  long long checked = 0, invalid = 0;
+  for (int a=1; a<argc; a++) {
+    solutionStream::Reader reader;
+    if (!reader.open(argv[a])) {
+      std::cout << argv[a] << ": cannot be read as solutions\n" << std::flush;
+      invalid++;
+      continue;
+    }
+
+    uint32_t max;
+    int boxNum;
+    std::vector<solutionStream::Run> runs;
+    bool broken;
+    long long record = 0;
+    while (reader.next(max, boxNum, runs, broken)) {
+      record++;
+      checked++;
+      std::string problem = check(max, boxNum, runs);
+      std::cout << argv[a] << ": solution " << record << ", 1 to " << max << " in " << boxNum << " boxes: ";
+      if (problem.empty()) {
+        std::cout << "valid\n";
+      } else {
+        std::cout << problem << '\n';
+        invalid++;
+      }
+    }
+    if (broken) {
+      std::cout << argv[a] << ": solution " << record+1 << " is cut short or cannot be read\n";
+      invalid++;
+    }
+    std::cout << std::flush;
+  }
+
+  // stop timer
+  long long duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+  std::cout << "  " << checked << " solutions checked, " << invalid << " problems\n";
+  std::cout << "  time is " << duration_ms << " ms\n" << std::flush;
+
+  return invalid ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/*
+  A small work-stealing thread pool used by the parallel search modes.
+
+  Each worker owns a deque of tasks. A worker pushes the tasks that it creates
+    onto the back of its own deque and pops from the back, so it keeps working
+    depth-first on the subtree it is already in (its data is still in cache).
+  An idle worker steals from the front of another worker's deque. The front
+    holds the oldest tasks, which are the shallowest and therefore the largest
+    subtrees, so a single steal moves a lot of work.
+
+  Tasks are coarse (whole subtrees of the search), so a mutex per deque is cheap
+    compared to the work being done and keeps the code easy to trust.
+
+  Usage...
+    WorkStealingPool pool(numThreads);
+    pool.submit(task);   // may also be called from inside a running task
+    pool.wait();         // returns once every task (and every task they created) is done
+*/
+
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class WorkStealingPool {
+
+public:
+
+  typedef std::function<void()> Task;
+
+  explicit WorkStealingPool(int numThreads) : queues(numThreads < 1 ? 1 : numThreads), pending(0), stopping(false) {
+    for (int i=0; i < (int)queues.size(); i++)
+      threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      stopping = true;
+    }
+    sleepCondition.notify_all();
+    for (int i=0; i < (int)threads.size(); i++)
+      threads[i].join();
+  }
+
+  int size() const { return (int)queues.size(); }
+
+  // tasks submitted but not yet finished, counting the running ones
+  long long pendingTasks() const { return pending.load(std::memory_order_relaxed); }
+
+  // index of the worker running the calling code, or -1 if not called from a worker
+  static int &workerIndex() {
+    static thread_local int index = -1;
+    return index;
+  }
+
+  void submit(Task task) {
+    pending++;
+    int i = workerIndex();
+    if (i < 0)   // submitted from outside the pool, so spread the work around
+      i = (int)(nextQueue++ % queues.size());
+    {
+      std::lock_guard<std::mutex> lock(queues[i].mutex);
+      queues[i].tasks.push_back(std::move(task));
+    }
+    sleepCondition.notify_one();
+  }
+
+  // block until there are no queued or running tasks
+  void wait() {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    doneCondition.wait(lock, [this]() { return pending.load() == 0; });
+  }
+
+private:
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  std::vector<Queue> queues;
+  std::vector<std::thread> threads;
+  std::atomic<long long> pending;     // tasks submitted but not yet finished
+  std::atomic<unsigned> nextQueue {0};
+  bool stopping;
+  std::mutex sleepMutex;
+  std::condition_variable sleepCondition;
+  std::condition_variable doneCondition;
+
+  bool popOwn(int i, Task &task) {
+    std::lock_guard<std::mutex> lock(queues[i].mutex);
+    if (queues[i].tasks.empty())
+      return false;
+    task = std::move(queues[i].tasks.back());
+    queues[i].tasks.pop_back();
+    return true;
+  }
+
+  bool steal(int thief, Task &task) {
+    int num = (int)queues.size();
+    for (int k=1; k < num; k++) {
+      int victim = (thief + k) % num;
+      std::lock_guard<std::mutex> lock(queues[victim].mutex);
+      if (!queues[victim].tasks.empty()) {
+        task = std::move(queues[victim].tasks.front());
+        queues[victim].tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void workerLoop(int i) {
+    workerIndex() = i;
+    Task task;
+    while (true) {
+      if (popOwn(i, task) || steal(i, task)) {
+        task();
+        task = nullptr;
+        if (--pending == 0) {
+          std::lock_guard<std::mutex> lock(sleepMutex);
+          doneCondition.notify_all();
+        }
+        continue;
+      }
+
+      // nothing to do, so sleep until more work arrives
+      // The timeout covers a task being pushed between the failed steal and the wait.
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      if (stopping)
+        return;
+      sleepCondition.wait_for(lock, std::chrono::milliseconds(2));
+    }
+  }
+
+};
+
+
+#endif